@@ -39,14 +39,19 @@
  * 1.2  20 Mar 2016  Ferry Toth - Fit into benchmarking
  * 1.3  07 May 2016  Ferry Toth - Applied some speed ups by putting more CRC32 in the short and long loop
  *                              - Moved crc32q into macro's and put alternative code there for 32bit operation
+ * 1.4  19 Oct 2026  - Added crc32cAdlerPclmul, shifting with pclmulqdq instead of the zeros tables
+ * 1.5  19 Oct 2026  - Block sizes are a template parameter list of tiers, added crc32cAdlerTiered
+ * 1.6  19 Oct 2026  - Shift tables generated at compile time instead of in a constructor
 */
 
 
 #include "logging/crc32c.h"
+#include "logging/crc32cshift.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <x86intrin.h>
 
 /* CRC-32C (iSCSI) polynomial in reversed bit order. */
 #define POLY 0x82f63b78
@@ -57,11 +62,10 @@ namespace logging
    GF(2).  Each element is a bit in an unsigned integer.  mat must have at
    least as many entries as the power of two for most significant one bit in
    vec. */
-static inline uint32_t gf2_matrix_times ( uint32_t *mat, uint32_t vec )
+static constexpr uint32_t gf2_matrix_times ( const uint32_t *mat, uint32_t vec )
 {
-        uint32_t sum;
+        uint32_t sum = 0;
 
-        sum = 0;
         while ( vec ) {
                 if ( vec & 1 )
                         sum ^= *mat;
@@ -73,11 +77,9 @@ static inline uint32_t gf2_matrix_times ( uint32_t *mat, uint32_t vec )
 
 /* Multiply a matrix by itself over GF(2).  Both mat and square must have 32
    rows. */
-static inline void gf2_matrix_square ( uint32_t *square, uint32_t *mat )
+static constexpr void gf2_matrix_square ( uint32_t *square, const uint32_t *mat )
 {
-        int n;
-
-        for ( n = 0; n < 32; n++ )
+        for ( int n = 0; n < 32; n++ )
                 square[n] = gf2_matrix_times ( mat, mat[n] );
 }
 
@@ -86,16 +88,14 @@ static inline void gf2_matrix_square ( uint32_t *square, uint32_t *mat )
    largest power of two less than len.  The result for len == 0 is the same as
    for len == 1.  A version of this routine could be easily written for any
    len, but that is not needed for this application. */
-static void crc32c_zeros_op ( uint32_t *even, size_t len )
+static constexpr void crc32c_zeros_op ( uint32_t *even, size_t len )
 {
-        int n;
-        uint32_t row;
-        uint32_t odd[32];       /* odd-power-of-two zeros operator */
+        uint32_t row = 1;
+        uint32_t odd[32] = {};  /* odd-power-of-two zeros operator */
 
         /* put operator for one zero bit in odd */
         odd[0] = POLY;              /* CRC-32C polynomial */
-        row = 1;
-        for ( n = 1; n < 32; n++ ) {
+        for ( int n = 1; n < 32; n++ ) {
                 odd[n] = row;
                 row <<= 1;
         }
@@ -119,19 +119,18 @@ static void crc32c_zeros_op ( uint32_t *even, size_t len )
         } while ( len );
 
         /* answer ended up in odd -- copy to even */
-        for ( n = 0; n < 32; n++ )
+        for ( int n = 0; n < 32; n++ )
                 even[n] = odd[n];
 }
 
 /* Take a length and build four lookup tables for applying the zeros operator
    for that length, byte-by-byte on the operand. */
-static void crc32c_zeros ( uint32_t zeros[][256], size_t len )
+static constexpr void crc32c_zeros ( uint32_t zeros[][256], size_t len )
 {
-        uint32_t n;
-        uint32_t op[32];
+        uint32_t op[32] = {};
 
         crc32c_zeros_op ( op, len );
-        for ( n = 0; n < 256; n++ ) {
+        for ( uint32_t n = 0; n < 256; n++ ) {
                 zeros[0][n] = gf2_matrix_times ( op, n );
                 zeros[1][n] = gf2_matrix_times ( op, n << 8 );
                 zeros[2][n] = gf2_matrix_times ( op, n << 16 );
@@ -141,7 +140,7 @@ static void crc32c_zeros ( uint32_t zeros[][256], size_t len )
 
 
 /* Apply the zeros operator table to crc. */
-static inline uint32_t crc32c_shift ( uint32_t zeros[][256], uint32_t crc )
+static inline uint32_t crc32c_shift ( const uint32_t zeros[][256], uint32_t crc )
 {
         return zeros[0][crc & 0xff] ^ zeros[1][ ( crc >> 8 ) & 0xff] ^
                zeros[2][ ( crc >> 16 ) & 0xff] ^ zeros[3][crc >> 24];
@@ -157,17 +156,21 @@ static inline uint32_t crc32c_shift ( uint32_t zeros[][256], uint32_t crc )
 #define SHORTx1 "256"
 #define SHORTx2 "512"
 
-/* Tables for hardware crc that shift a crc by LONG and SHORT zeros. */
-static uint32_t crc32c_long[4][256];
-static uint32_t crc32c_short[4][256];
+/* Tables for shifting crcs, built at compile time so they end up in .rodata
+   instead of being filled by a constructor in every program linking the library. */
+struct crc32c_zeros_table {
+        uint32_t zeros[4][256];
 
-/* Initialize tables for shifting crcs. */
-static void crc32c_init_hw ( void ) __attribute__ ( ( constructor ) );
-static void crc32c_init_hw ( void )
-{
-        crc32c_zeros ( crc32c_long, LONG );
-        crc32c_zeros ( crc32c_short, SHORT );
-}
+        constexpr crc32c_zeros_table ( size_t len ) : zeros() {
+                crc32c_zeros ( zeros, len );
+        }
+};
+
+/* Tables for hardware crc that shift a crc by LONG and SHORT zeros. */
+static constexpr crc32c_zeros_table crc32c_long_table ( LONG );
+static constexpr crc32c_zeros_table crc32c_short_table ( SHORT );
+static constexpr const uint32_t ( &crc32c_long ) [4][256] = crc32c_long_table.zeros;
+static constexpr const uint32_t ( &crc32c_short ) [4][256] = crc32c_short_table.zeros;
 
 #ifndef __LP64__
 #define CRCtriplet(crc, buf, size, i) \
@@ -194,16 +197,105 @@ static void crc32c_init_hw ( void )
 #define CRCsinglet(crc, buf) crc = __builtin_ia32_crc32di(crc, *(uint64_t*)buf); buf+= sizeof(uint64_t);
 #endif
 
-/* Compute CRC-32C using the Intel hardware instruction. */
-uint32_t crc32cAdler ( uint32_t crc, const void *buf, size_t len )
+#ifndef __LP64__
+#define CRC_NATIVE uint32_t
+#else
+#define CRC_NATIVE uint64_t     /* need to be 64 bits for crc32q */
+#endif
+
+/* Shift crcs over LONG and SHORT zeros with the tables above. */
+struct TableShift {
+        template <size_t Bytes>
+        static inline uint32_t shift ( uint32_t crc );
+};
+
+template <>
+inline uint32_t TableShift::shift<LONG> ( uint32_t crc )
 {
-        const unsigned char *next = ( const unsigned char * ) buf;
-        const unsigned char *end;
+        return crc32c_shift ( crc32c_long, crc );
+}
+
+template <>
+inline uint32_t TableShift::shift<SHORT> ( uint32_t crc )
+{
+        return crc32c_shift ( crc32c_short, crc );
+}
+
+/* Shift a crc over 8 * n zeros without tables: pclmulqdq by K(n) = x^(64n-33) mod P gives a
+   64 bit value (see crc32cshift.h) and a crc32 of that value on a zero crc reduces it to
+   crc * x^(64n) mod P. This costs a clmul and a crc32q (two crc32l on 32 bit), but reads no
+   memory, where the tables read four cache lines out of 8 KiB that are likely cold. */
+static inline uint32_t crc32c_shift_pclmul ( uint32_t k, uint32_t crc )
+{
+        __m128i prod = _mm_clmulepi64_si128 ( _mm_cvtsi32_si128 ( crc ), _mm_cvtsi32_si128 ( k ), 0x00 );
 #ifndef __LP64__
-        uint32_t crc0, crc1, crc2;
+        uint32_t crc32bit = __builtin_ia32_crc32si ( 0, _mm_cvtsi128_si32 ( prod ) );
+        return __builtin_ia32_crc32si ( crc32bit, _mm_extract_epi32 ( prod, 1 ) );
 #else
-        uint64_t crc0, crc1, crc2;      /* need to be 64 bits for crc32q */
+        return ( uint32_t ) __builtin_ia32_crc32di ( 0, _mm_cvtsi128_si64 ( prod ) );
 #endif
+}
+
+/* Shift crcs over any multiple of 8 zeros with pclmulqdq. */
+struct PclmulShift {
+        template <size_t Bytes>
+        static inline uint32_t shift ( uint32_t crc ) {
+                static constexpr uint32_t K = crc32cXPow ( 8 * Bytes - 33 );
+                return crc32c_shift_pclmul ( K, crc );
+        }
+};
+
+/* Compute the crc on sets of Tier*3 bytes, executing three independent crc
+   instructions, each on Tier bytes -- this is optimized for the Nehalem,
+   Westmere, Sandy Bridge, and Ivy Bridge architectures, which have a
+   throughput of one crc per cycle, but a latency of three cycles. Tier must be
+   a multiple of 32. */
+template <class Shift, size_t Tier>
+static inline void crc32cAdlerTier ( CRC_NATIVE &crc0, const unsigned char *&next, size_t &len )
+{
+        CRC_NATIVE crc1, crc2;
+        const unsigned char *end;
+
+        while ( len >= Tier*3 ) {
+                crc1 = 0;
+                crc2 = 0;
+                end = next + Tier;
+                do {
+                        CRCtriplet ( crc, next, Tier, 0 );
+                        CRCtriplet ( crc, next, Tier, 8 );
+                        CRCtriplet ( crc, next, Tier, 16 );
+                        CRCtriplet ( crc, next, Tier, 24 );
+                        next += 32;
+                } while ( next < end );
+                crc0 = Shift::template shift<Tier> ( crc0 ) ^ crc1;
+                crc0 = Shift::template shift<Tier> ( crc0 ) ^ crc2;
+                next += Tier*2;
+                len -= Tier*3;
+        }
+}
+
+/* Run the tiers from large to small. Each tier takes what is left by the larger
+   ones, so the number of combines is the least for the given tiers. */
+template <class Shift>
+static inline void crc32cAdlerTiers ( CRC_NATIVE &, const unsigned char *&, size_t & )
+{
+}
+
+template <class Shift, size_t Tier, size_t... Smaller>
+static inline void crc32cAdlerTiers ( CRC_NATIVE &crc0, const unsigned char *&next, size_t &len )
+{
+        static_assert ( Tier % 32 == 0, "tiers must be a multiple of 32 bytes" );
+        crc32cAdlerTier<Shift, Tier> ( crc0, next, len );
+        crc32cAdlerTiers<Shift, Smaller...> ( crc0, next, len );
+}
+
+/* Compute CRC-32C using the Intel hardware instruction. Shift decides how the
+   three lanes are combined, Tiers are the lane sizes in bytes from large to small. */
+template <class Shift, size_t... Tiers>
+static inline uint32_t crc32cAdlerKernel ( uint32_t crc, const void *buf, size_t len )
+{
+        const unsigned char *next = ( const unsigned char * ) buf;
+        CRC_NATIVE crc0;
         uint32_t crc32bit;
 
         crc32bit = crc;
@@ -226,50 +318,11 @@ uint32_t crc32cAdler ( uint32_t crc, const void *buf, size_t len )
                 }
         };
 
-        /* compute the crc on sets of LONG*3 bytes, executing three independent crc
-           instructions, each on LONG bytes -- this is optimized for the Nehalem,
-           Westmere, Sandy Bridge, and Ivy Bridge architectures, which have a
-           throughput of one crc per cycle, but a latency of three cycles */
-
         crc0 = crc32bit;
-        while ( len >= LONG*3 ) {
-                crc1 = 0;
-                crc2 = 0;
-                end = next + LONG;
-                do {
-                        CRCtriplet ( crc, next, LONG, 0 );
-                        CRCtriplet ( crc, next, LONG, 8 );
-                        CRCtriplet ( crc, next, LONG, 16 );
-                        CRCtriplet ( crc, next, LONG, 24 );
-                        next += 32;
-                } while ( next < end );
-                crc0 = crc32c_shift ( crc32c_long, crc0 ) ^ crc1;
-                crc0 = crc32c_shift ( crc32c_long, crc0 ) ^ crc2;
-                next += LONG*2;
-                len -= LONG*3;
-        }
+        crc32cAdlerTiers<Shift, Tiers...> ( crc0, next, len );
 
-        /* do the same thing, but now on SHORT*3 blocks for the remaining data less
-           than a LONG*3 block */
-        while ( len >= SHORT*3 ) {
-                crc1 = 0;
-                crc2 = 0;
-                end = next + SHORT;
-                do {
-                        CRCtriplet ( crc, next, SHORT, 0 );
-                        CRCtriplet ( crc, next, SHORT, 8 );
-                        CRCtriplet ( crc, next, SHORT, 16 );
-                        CRCtriplet ( crc, next, SHORT, 24 );
-                        next += 32;
-                } while ( next < end );
-                crc0 = crc32c_shift ( crc32c_short, crc0 ) ^ crc1;
-                crc0 = crc32c_shift ( crc32c_short, crc0 ) ^ crc2;
-                next += SHORT*2;
-                len -= SHORT*3;
-        }
-
-        /* compute the crc on the remaining eight-byte units less than a SHORT*3
-           block */
+        /* compute the crc on the remaining eight-byte units less than a block of
+           the smallest tier */
 
         // use Duff's device, a for() loop inside a switch() statement. This is Legal
         unsigned short count;
@@ -334,5 +387,20 @@ uint32_t crc32cAdler ( uint32_t crc, const void *buf, size_t len )
         return ( uint32_t ) crc32bit;
 }
 
+uint32_t crc32cAdler ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cAdlerKernel<TableShift, LONG, SHORT> ( crc, buf, len );
+}
+
+uint32_t crc32cAdlerPclmul ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cAdlerKernel<PclmulShift, LONG, SHORT> ( crc, buf, len );
+}
+
+uint32_t crc32cAdlerTiered ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cAdlerKernel<PclmulShift, 8192, 1024, 256, 64> ( crc, buf, len );
+}
+
 }  // namespace logging
 // kate: indent-mode cstyle; indent-width 8; replace-tabs on; 
@@ -6,41 +6,252 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <cpuid.h>
 
 
+#include "logging/crc32cshift.h"
 #include "logging/crc32ctables.h"
 
 namespace logging {
 
 static uint32_t crc32c_CPUDetection(uint32_t crc, const void* data, size_t length) {
     // Avoid issues that could potentially be caused by multiple threads: use a local variable
-    CRC32CFunctionPtr best = detectBestCRC32C();
+    CRC32CFunctionPtr best = crc32cStatsFunction(*crc32cFindKernel(crc32cDispatch().kernel));
     crc32c = best;
     return best(crc, data, length);
 }
 
 CRC32CFunctionPtr crc32c = crc32c_CPUDetection;
 
-CRC32CFunctionPtr detectBestCRC32C() {
+/* Kernels for known microarchitectures, for processors with SSE 4.2 and pclmulqdq. The first
+matching entry wins; model 0 matches any model of the family. */
+struct CRC32CMicroarchitecture {
+    const char* vendor;
+    unsigned family;
+    unsigned model;
+    const char* name;
+    CRC32CFunctionPtr kernel;
+    const char* kernelName;
+};
+
+#ifdef __LP64__
+#define CRC32C_KERNEL(k64, k32) k64, # k64
+#else
+#define CRC32C_KERNEL(k64, k32) k32, # k32
+#endif
+static const CRC32CMicroarchitecture MICROARCHITECTURES[] = {
+    // Edison and the NUC E3815: the multi lane kernels regress on 64 bit, see the README
+    { "GenuineIntel", 6, 0x37, "Silvermont", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    { "GenuineIntel", 6, 0x4a, "Silvermont", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    { "GenuineIntel", 6, 0x4d, "Silvermont", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    { "GenuineIntel", 6, 0x5a, "Silvermont", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    { "GenuineIntel", 6, 0x5d, "Silvermont", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    { "GenuineIntel", 6, 0x4c, "Airmont", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    // Xeon Phi: Silvermont derived cores, with the same slow crc32 and pclmulqdq
+    { "GenuineIntel", 6, 0x57, "Knights Landing", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    { "GenuineIntel", 6, 0x85, "Knights Mill", CRC32C_KERNEL(crc32cHardware64, crc32cIntelC) },
+    // the later Atoms pipeline crc32 (3 cycles, one per cycle) and have a faster pclmulqdq, so the
+    // three lanes pay off as on the big cores; listed so the dispatch reports their name
+    { "GenuineIntel", 6, 0x5c, "Goldmont", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "GenuineIntel", 6, 0x5f, "Goldmont", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "GenuineIntel", 6, 0x7a, "Goldmont Plus", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "GenuineIntel", 6, 0x86, "Tremont", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "GenuineIntel", 6, 0x96, "Tremont", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "GenuineIntel", 6, 0x9c, "Tremont", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    // any other model with pclmulqdq is a big core, Westmere and later: three crc32q lanes hide
+    // the latency
+    { "GenuineIntel", 6, 0, "Intel family 6", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "AuthenticAMD", 0x17, 0, "Zen, Zen 2", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "AuthenticAMD", 0x19, 0, "Zen 3, Zen 4", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+    { "AuthenticAMD", 0x1a, 0, "Zen 5", CRC32C_KERNEL(crc32cIntelC, crc32cPclmulFold) },
+};
+#undef CRC32C_KERNEL
+
+/* Every kernel with the CRC32CFunctionPtr signature. The lengths are where the kernel is worth
+considering: below minLength its main loop does not run or a single crc32 chain is as fast, above
+maxLength a kernel built for that size wins. */
+#define MAKE_KERNEL(x, isa, minLength, maxLength) { # x, isa, minLength, maxLength, x }
+static const CRC32CKernel KERNELS[] = {
+    MAKE_KERNEL(crc32cSarwate, CRC32C_ISA_NONE, 0, 16),
+    MAKE_KERNEL(crc32cNibble, CRC32C_ISA_NONE, 0, 64),
+    MAKE_KERNEL(crc32cNibblePair, CRC32C_ISA_NONE, 0, 64),
+    MAKE_KERNEL(crc32cSlicingBy4, CRC32C_ISA_NONE, 8, SIZE_MAX),
+    MAKE_KERNEL(crc32cSlicingBy8, CRC32C_ISA_NONE, 16, SIZE_MAX),
+    MAKE_KERNEL(crc32cSlicingBy16, CRC32C_ISA_NONE, 32, SIZE_MAX),
+    MAKE_KERNEL(crc32cBraid, CRC32C_ISA_NONE, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cHardware32, CRC32C_ISA_SSE42, 0, 64),
+    MAKE_KERNEL(crc32cPclmul, CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cPclmulFold, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cHardware64, CRC32C_ISA_SSE42, 0, 32),
+#ifdef __LP64__
+    MAKE_KERNEL(crc32cIntelAsm, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 216, SIZE_MAX),
+#endif
+    MAKE_KERNEL(crc32cAdler, CRC32C_ISA_SSE42, 768, SIZE_MAX),
+    MAKE_KERNEL(crc32cAdlerPclmul, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 768, SIZE_MAX),
+    MAKE_KERNEL(crc32cAdlerTiered, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 192, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 32, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelCAdaptive, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 32, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelCLoop, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 0, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelCCompact, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 0, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelCPrefetch, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 12 * 1024, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC2, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 32, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC4, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC5, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC6, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC7, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cIntelC8, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL, 64, SIZE_MAX),
+    MAKE_KERNEL(crc32cVpclmul, CRC32C_ISA_SSE42 | CRC32C_ISA_PCLMUL | CRC32C_ISA_AVX512, 32, SIZE_MAX),
+};
+#undef MAKE_KERNEL
+
+const CRC32CKernel* crc32cKernels(size_t* count) {
+    *count = sizeof(KERNELS)/sizeof(*KERNELS);
+    return KERNELS;
+}
+
+unsigned crc32cSupportedISA() {
     unsigned int eax, ebx = 0, ecx = 0, edx;
+    unsigned isa = CRC32C_ISA_NONE;
+    unsigned int max_level = __get_cpuid_max(0, NULL);
+
+    if (max_level >= 1) {
+        __cpuid(1, eax, ebx, ecx, edx);
+    }
+    if (ecx & bit_SSE4_2) {
+        isa |= CRC32C_ISA_SSE42;
+    }
+    if ((ecx & bit_PCLMUL) && (ecx & bit_SSE4_1)) {
+        isa |= CRC32C_ISA_PCLMUL;
+    }
+
+    // the zmm registers also need the operating system to save them: XCR0 bits 1, 2 and 5 to 7
+    if (max_level >= 7 && (ecx & bit_OSXSAVE)) {
+        unsigned int xcr0, xcr0High;
+        asm("xgetbv" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if ((xcr0 & 0xe6) == 0xe6 && (ebx & bit_AVX512F) && (ebx & bit_AVX512VL) &&
+                (ecx & bit_VPCLMULQDQ) && (isa & CRC32C_ISA_SSE42) && (isa & CRC32C_ISA_PCLMUL)) {
+            isa |= CRC32C_ISA_AVX512;
+        }
+    }
+    return isa;
+}
+
+bool crc32cKernelUsable(const CRC32CKernel& kernel) {
+    return (kernel.isa & ~crc32cSupportedISA()) == 0;
+}
+
+const CRC32CKernel* crc32cFindKernel(const char* name) {
+    for (const CRC32CKernel& kernel : KERNELS) {
+        if (strcmp(kernel.name, name) == 0) {
+            return &kernel;
+        }
+    }
+    return NULL;
+}
+
+/* The kernel named by the CRC32C_KERNEL environment variable, if it is usable here. */
+static const CRC32CKernel* crc32cEnvironmentKernel() {
+    const char* name = getenv("CRC32C_KERNEL");
+    if (name == NULL || *name == '\0') {
+        return NULL;
+    }
+    const CRC32CKernel* kernel = crc32cFindKernel(name);
+    return kernel != NULL && crc32cKernelUsable(*kernel) ? kernel : NULL;
+}
+
+CRC32CDispatch crc32cDispatch() {
+    CRC32CDispatch dispatch;
+    memset(&dispatch, 0, sizeof(dispatch));
+
+    unsigned int eax, ebx = 0, ecx = 0, edx = 0;
     unsigned int max_level;
-    
+
     max_level = __get_cpuid_max(0, NULL);
     if (max_level >= 1) {
+        __cpuid(0, eax, ebx, ecx, edx);
+        memcpy(dispatch.vendor, &ebx, 4);
+        memcpy(dispatch.vendor + 4, &edx, 4);
+        memcpy(dispatch.vendor + 8, &ecx, 4);
+
         __cpuid(1, eax, ebx, ecx, edx);
-    };
-    bool hasSSE42 = (ecx & bit_SSE4_2);
-    if (hasSSE42) {
+        dispatch.family = (eax >> 8) & 0x0f;
+        dispatch.model = (eax >> 4) & 0x0f;
+        if (dispatch.family == 0x0f) {
+            dispatch.family += (eax >> 20) & 0xff;
+        }
+        if (dispatch.family == 6 || dispatch.family >= 0x0f) {
+            dispatch.model |= ((eax >> 16) & 0x0f) << 4;
+        }
+    }
+    unsigned isa = crc32cSupportedISA();
+    dispatch.sse42 = (isa & CRC32C_ISA_SSE42) != 0;
+    dispatch.pclmul = (isa & CRC32C_ISA_PCLMUL) != 0;
+
+    const CRC32CKernel* forced = crc32cEnvironmentKernel();
+    if (forced != NULL) {
+        dispatch.forced = true;
+        dispatch.kernel = forced->name;
+        dispatch.function = forced->function;
+        return dispatch;
+    }
+
+    if (dispatch.sse42 && dispatch.pclmul) {
+        for (const CRC32CMicroarchitecture& uarch : MICROARCHITECTURES) {
+            if (strcmp(dispatch.vendor, uarch.vendor) == 0 && dispatch.family == uarch.family &&
+                    (uarch.model == 0 || dispatch.model == uarch.model)) {
+                dispatch.microarchitecture = uarch.name;
+                dispatch.kernel = uarch.kernelName;
+                dispatch.function = uarch.kernel;
+                // the big cores with 512 bit vpclmulqdq, Ice Lake and Zen 4 on, fold 4 times as wide
+                if ((isa & CRC32C_ISA_AVX512) &&
+                        (uarch.kernel == crc32cIntelC || uarch.kernel == crc32cPclmulFold)) {
+                    dispatch.kernel = "crc32cVpclmul";
+                    dispatch.function = crc32cVpclmul;
+                }
+                return dispatch;
+            }
+        }
+    }
+
+    // not in the table, or missing one of the instructions: go by the feature bits alone
+    if (dispatch.sse42) {
 #ifdef __LP64__
-        return crc32cHardware64;
+        dispatch.kernel = "crc32cHardware64";
+        dispatch.function = crc32cHardware64;
 #else
-        return crc32cHardware32;
+        // without crc32q, folding with pclmulqdq beats serial crc32l from 64 bytes on
+        dispatch.kernel = dispatch.pclmul ? "crc32cPclmulFold" : "crc32cHardware32";
+        dispatch.function = dispatch.pclmul ? crc32cPclmulFold : crc32cHardware32;
 #endif
+    } else if (dispatch.pclmul) {
+        // crc32 disabled, as some hypervisors do, but carry-less multiply is there
+        dispatch.kernel = "crc32cPclmul";
+        dispatch.function = crc32cPclmul;
     } else {
-        return crc32cSlicingBy8;
+        dispatch.kernel = "crc32cBraid";
+        dispatch.function = crc32cBraid;
+    }
+    return dispatch;
+}
+
+CRC32CFunctionPtr detectBestCRC32C() {
+    return crc32cDispatch().function;
+}
+
+bool crc32cForceKernel(const char* name) {
+    if (name == NULL) {
+        crc32c = crc32c_CPUDetection;
+        return true;
+    }
+    const CRC32CKernel* kernel = crc32cFindKernel(name);
+    if (kernel == NULL || !crc32cKernelUsable(*kernel)) {
+        return false;
     }
+    crc32c = crc32cStatsFunction(*kernel);
+    return true;
 }
 
 // Implementations adapted from Intel's Slicing By 8 Sourceforge Project
@@ -66,6 +277,36 @@ uint32_t crc32cSarwate(uint32_t crc, const void* data, size_t length) {
     return crc;
 }
 
+/* Sarwate with a 16 entry table, 4 bits per lookup: the table is one cache line, where
+crc_tableil8_o32 is sixteen. Two lookups per byte, one depending on the other. */
+uint32_t crc32cNibble(uint32_t crc, const void* data, size_t length) {
+    const char* p_buf = (const char*) data;
+    const char* p_end = p_buf + length;
+
+    while (p_buf < p_end) {
+        crc ^= (unsigned char) *p_buf++;
+        crc = crc_tableil4_o32[crc & 0x0F] ^ (crc >> 4);
+        crc = crc_tableil4_o32[crc & 0x0F] ^ (crc >> 4);
+    }
+
+    return crc;
+}
+
+/* A byte per step from two 16 entry tables, two cache lines: the low nibble from the first
+entries of crc_tableil8_o32, the high nibble from crc_tableil4_o32. The lookups do not depend
+on each other. */
+uint32_t crc32cNibblePair(uint32_t crc, const void* data, size_t length) {
+    const char* p_buf = (const char*) data;
+    const char* p_end = p_buf + length;
+
+    while (p_buf < p_end) {
+        crc ^= (unsigned char) *p_buf++;
+        crc = crc_tableil8_o32[crc & 0x0F] ^ crc_tableil4_o32[(crc >> 4) & 0x0F] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
 uint32_t crc32cSlicingBy4(uint32_t crc, const void* data, size_t length) {
     const char* p_buf = (const char*) data;
 
@@ -138,94 +379,144 @@ uint32_t crc32cSlicingBy8(uint32_t crc, const void* data, size_t length) {
     return crc;
 }
 
-// Hardware-accelerated CRC-32C (using CRC32 instruction)
-uint32_t crc32cHardware32(uint32_t crc, const void* data, size_t length) {
+uint32_t crc32cSlicingBy16(uint32_t crc, const void* data, size_t length) {
     const char* p_buf = (const char*) data;
-    // alignment doesn't seem to help?
-    for (size_t i = 0; i < length / sizeof(uint32_t); i++) {
-        crc = __builtin_ia32_crc32si(crc, *(uint32_t*) p_buf);
-        p_buf += sizeof(uint32_t);
-    }
-
-    // This ugly switch is slightly faster for short strings than the straightforward loop
-    length &= sizeof(uint32_t) - 1;
-    /*
-    while (length > 0) {
-        crc32bit = __builtin_ia32_crc32qi(crc32bit, *p_buf++);
-        length--;
-    }
-    */
-    switch (length) {
-        case 3:
-            crc = __builtin_ia32_crc32qi(crc, *p_buf++);
-        case 2:
-            crc = __builtin_ia32_crc32hi(crc, *(uint16_t*) p_buf);
-            break;
-        case 1:
-            crc = __builtin_ia32_crc32qi(crc, *p_buf);
-            break;
-        case 0:
-            break;
-        default:
-            // This should never happen; enable in debug code
-            assert(false);
+
+    // Handle leading misaligned bytes, up to an 8 byte boundary for the 64 bit loads
+    size_t initial_bytes = (sizeof(uint64_t) - (intptr_t)p_buf) & (sizeof(uint64_t) - 1);
+    if (length < initial_bytes) initial_bytes = length;
+    for (size_t li = 0; li < initial_bytes; li++) {
+        crc = crc_tableil8_o32[(crc ^ *p_buf++) & 0x000000FF] ^ (crc >> 8);
+    }
+
+    length -= initial_bytes;
+    size_t running_length = length & ~(2 * sizeof(uint64_t) - 1);
+    size_t end_bytes = length - running_length;
+
+    for (size_t li = 0; li < running_length/16; li++) {
+        uint64_t a = *(const uint64_t*) p_buf ^ crc;
+        uint64_t b = *(const uint64_t*) (p_buf + 8);
+        p_buf += 16;
+        crc = crc_tableil8_o152[a & 0xFF] ^
+              crc_tableil8_o144[(a >> 8) & 0xFF] ^
+              crc_tableil8_o136[(a >> 16) & 0xFF] ^
+              crc_tableil8_o128[(a >> 24) & 0xFF] ^
+              crc_tableil8_o120[(a >> 32) & 0xFF] ^
+              crc_tableil8_o112[(a >> 40) & 0xFF] ^
+              crc_tableil8_o104[(a >> 48) & 0xFF] ^
+              crc_tableil8_o96[a >> 56] ^
+              crc_tableil8_o88[b & 0xFF] ^
+              crc_tableil8_o80[(b >> 8) & 0xFF] ^
+              crc_tableil8_o72[(b >> 16) & 0xFF] ^
+              crc_tableil8_o64[(b >> 24) & 0xFF] ^
+              crc_tableil8_o56[(b >> 32) & 0xFF] ^
+              crc_tableil8_o48[(b >> 40) & 0xFF] ^
+              crc_tableil8_o40[(b >> 48) & 0xFF] ^
+              crc_tableil8_o32[b >> 56];
+    }
+
+    for (size_t li=0; li < end_bytes; li++) {
+        crc = crc_tableil8_o32[(crc ^ *p_buf++) & 0x000000FF] ^ (crc >> 8);
     }
 
     return crc;
 }
 
-// Hardware-accelerated CRC-32C (using CRC32 instruction)
-uint32_t crc32cHardware64(uint32_t crc, const void* data, size_t length) {
-#ifndef __LP64__
-    return crc32cHardware32(crc, data, length);
-#else
+/* Tables of the braided kernel. The words of a braid are N words apart; braid[k][n] is byte n
+at offset k of a word, carried to the start of the braid's next word: the table crc of n times
+x^(8(7-k) + 64(N-1)). With N = 1 these would be the slicing by 8 tables, which the serial
+steps read instead (crc32cSlicingWord). */
+template <unsigned N>
+struct CRC32CBraidTable {
+    uint32_t braid[8][256];
+
+    constexpr CRC32CBraidTable() : braid() {
+        for (unsigned k = 0; k < 8; ++k) {
+            uint32_t shift = crc32cXPow(8 * (7 - k) + 64 * (N - 1));
+            for (unsigned n = 0; n < 256; ++n) {
+                uint32_t crc = n;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = crc32cMulX(crc);
+                }
+                braid[k][n] = crc32cMultiply(crc, shift);
+            }
+        }
+    }
+};
+
+template <unsigned N>
+static inline uint32_t crc32cBraidWord(const CRC32CBraidTable<N>& table, uint64_t word) {
+    return table.braid[0][word & 0xff] ^ table.braid[1][(word >> 8) & 0xff] ^
+            table.braid[2][(word >> 16) & 0xff] ^ table.braid[3][(word >> 24) & 0xff] ^
+            table.braid[4][(word >> 32) & 0xff] ^ table.braid[5][(word >> 40) & 0xff] ^
+            table.braid[6][(word >> 48) & 0xff] ^ table.braid[7][word >> 56];
+}
+
+/* The crc of a 64 bit word, with the slicing by 8 tables. */
+static inline uint32_t crc32cSlicingWord(uint64_t word) {
+    return crc_tableil8_o88[word & 0xff] ^ crc_tableil8_o80[(word >> 8) & 0xff] ^
+            crc_tableil8_o72[(word >> 16) & 0xff] ^ crc_tableil8_o64[(word >> 24) & 0xff] ^
+            crc_tableil8_o56[(word >> 32) & 0xff] ^ crc_tableil8_o48[(word >> 40) & 0xff] ^
+            crc_tableil8_o40[(word >> 48) & 0xff] ^ crc_tableil8_o32[word >> 56];
+}
+
+/* zlib's braided crc: N independent crcs over interleaved 64 bit words, so N table lookup
+chains run in parallel where slicing by 8 has one. The last N words combine them serially.
+Plain C++ without intrinsics, for processors without the crc32 instruction. */
+template <unsigned N>
+static uint32_t crc32cBraidN(uint32_t crc, const void* data, size_t length) {
+    static constexpr CRC32CBraidTable<N> table {};
     const char* p_buf = (const char*) data;
-    // alignment doesn't seem to help?
-    uint64_t crc64bit = crc;
-    for (size_t i = 0; i < length / sizeof(uint64_t); i++) {
-        crc64bit = __builtin_ia32_crc32di(crc64bit, *(uint64_t*) p_buf);
-        p_buf += sizeof(uint64_t);
-    }
-
-    // This ugly switch is slightly faster for short strings than the straightforward loop
-    uint32_t crc32bit = (uint32_t) crc64bit;
-    length &= sizeof(uint64_t) - 1;
-    /*
-    while (length > 0) {
-        crc32bit = __builtin_ia32_crc32qi(crc32bit, *p_buf++);
-        length--;
-    }
-    */
-    switch (length) {
-        case 7:
-            crc32bit = __builtin_ia32_crc32qi(crc32bit, *p_buf++);
-        case 6:
-            crc32bit = __builtin_ia32_crc32hi(crc32bit, *(uint16_t*) p_buf);
-            p_buf += 2;
-        // case 5 is below: 4 + 1
-        case 4:
-            crc32bit = __builtin_ia32_crc32si(crc32bit, *(uint32_t*) p_buf);
-            break;
-        case 3:
-            crc32bit = __builtin_ia32_crc32qi(crc32bit, *p_buf++);
-        case 2:
-            crc32bit = __builtin_ia32_crc32hi(crc32bit, *(uint16_t*) p_buf);
-            break;
-        case 5:
-            crc32bit = __builtin_ia32_crc32si(crc32bit, *(uint32_t*) p_buf);
-            p_buf += 4;
-        case 1:
-            crc32bit = __builtin_ia32_crc32qi(crc32bit, *p_buf);
-            break;
-        case 0:
-            break;
-        default:
-            // This should never happen; enable in debug code
-            assert(false);
-    }
-
-    return crc32bit;
-#endif
+
+    // Handle leading misaligned bytes
+    size_t initial_bytes = (sizeof(uint64_t) - (intptr_t)p_buf) & (sizeof(uint64_t) - 1);
+    if (length < initial_bytes) initial_bytes = length;
+    for (size_t li = 0; li < initial_bytes; li++) {
+        crc = crc_tableil8_o32[(crc ^ *p_buf++) & 0x000000FF] ^ (crc >> 8);
+    }
+    length -= initial_bytes;
+
+    size_t blocks = length / (N * sizeof(uint64_t));
+    if (blocks >= 2) {
+        const uint64_t* words = (const uint64_t*) p_buf;
+        uint32_t crcs[N] = { crc };
+        for (size_t block = 0; block < blocks - 1; ++block) {
+            uint64_t word[N];
+            for (unsigned j = 0; j < N; ++j) {
+                word[j] = crcs[j] ^ words[j];
+            }
+            words += N;
+            for (unsigned j = 0; j < N; ++j) {
+                crcs[j] = crc32cBraidWord(table, word[j]);
+            }
+        }
+
+        crc = 0;
+        for (unsigned j = 0; j < N; ++j) {
+            crc = crc32cSlicingWord(crc ^ crcs[j] ^ words[j]);
+        }
+        p_buf += blocks * N * sizeof(uint64_t);
+        length -= blocks * N * sizeof(uint64_t);
+    }
+
+    return crc32cSlicingBy8(crc, p_buf, length);
+}
+
+uint32_t crc32cBraid(uint32_t crc, const void* data, size_t length) {
+    return crc32cBraidN<5>(crc, data, length);
+}
+
+
+void* crc32cPaddedAlloc(size_t length) {
+    void* buffer;
+    if (posix_memalign(&buffer, 64, length + CRC32C_PADDING) != 0) {
+        return NULL;
+    }
+    return buffer;
+}
+
+void crc32cPaddedFree(void* buffer) {
+    free(buffer);
 }
 
 }  // namespace logging
@@ -4,8 +4,13 @@
 
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 #include "logging/crc32c.h"
+#include "logging/crc32cshift.h"
 #include "stupidunit/stupidunit.h"
 
 using namespace logging;
@@ -24,42 +29,131 @@ TEST(CRC32C, CPUDetection) {
     EXPECT_EQ(final, detectBestCRC32C());
 }
 
-struct CRC32CFunctionInfo {
-    CRC32CFunctionPtr crcfn;
-    const char* name;
-};
+TEST(CRC32C, Dispatch) {
+    CRC32CDispatch dispatch = crc32cDispatch();
+    EXPECT_EQ(detectBestCRC32C(), dispatch.function);
+    EXPECT_TRUE(dispatch.kernel != NULL);
+    EXPECT_EQ(12, strlen(dispatch.vendor));
+    // the table is only used when both instructions are there
+    if (dispatch.microarchitecture != NULL) {
+        EXPECT_TRUE(dispatch.sse42 && dispatch.pclmul);
+    }
+
+    static const char PHRASE[] = "The quick brown fox jumps over the lazy dog";
+    EXPECT_EQ(crc32cLiteral(PHRASE), crc32cFinish(dispatch.function(crc32cInit(), PHRASE, sizeof(PHRASE) - 1)));
+}
+
+// The counters of one kernel, zero if it had no calls
+static CRC32CKernelStats kernelStats(const char* name) {
+    CRC32CKernelStats stats[64];
+    size_t count = crc32cStatsSnapshot(stats, 64);
+    for (size_t i = 0; i < count; ++i) {
+        if (strcmp(stats[i].name, name) == 0) {
+            return stats[i];
+        }
+    }
+    CRC32CKernelStats none;
+    memset(&none, 0, sizeof(none));
+    return none;
+}
 
-#define MAKE_FN_STRUCT(x) { x, # x }
-static const CRC32CFunctionInfo FNINFO[] = {
-    MAKE_FN_STRUCT(crc32cSarwate),
-    MAKE_FN_STRUCT(crc32cSlicingBy4),
-    MAKE_FN_STRUCT(crc32cSlicingBy8),
-    MAKE_FN_STRUCT(crc32cHardware32),
-#ifdef __LP64__
-    MAKE_FN_STRUCT(crc32cHardware64),
-    MAKE_FN_STRUCT(crc32cIntelAsm),
-#endif
-    MAKE_FN_STRUCT(crc32cAdler),
-    MAKE_FN_STRUCT(crc32cIntelC),
+// Calls crc32c when its thread exits
+struct CRC32CAtThreadExit {
+    ~CRC32CAtThreadExit() {
+        static const char data[5] = { 0 };
+        crc32c(crc32cInit(), data, sizeof(data));
+    }
 };
-#undef MAKE_FN_STRUCT
-
-static size_t numValidFunctions() {
-    size_t numFunctions = sizeof(FNINFO)/sizeof(*FNINFO);
-    bool hasHardware = (detectBestCRC32C() != crc32cSlicingBy8);
-    if (!hasHardware) {
-        while (FNINFO[numFunctions-1].crcfn == crc32cHardware32 ||
-                FNINFO[numFunctions-1].crcfn == crc32cHardware64 ||
-                FNINFO[numFunctions-1].crcfn == crc32cIntelC) {
-            numFunctions -= 1;
+
+TEST(CRC32C, Stats) {
+    static char buffer[4096];
+    crc32c(crc32cInit(), NULL, 0);
+    CRC32CFunctionPtr kernel = crc32c;
+    const char* name = crc32cDispatch().kernel;
+
+    crc32cEnableStats(true);
+    EXPECT_TRUE(crc32cStatsEnabled());
+    EXPECT_NE(kernel, crc32c);
+    EXPECT_EQ(kernel(crc32cInit(), buffer, 100), crc32c(crc32cInit(), buffer, 100));
+
+    CRC32CKernelStats before = kernelStats(name);
+    crc32c(crc32cInit(), buffer, 0);
+    crc32c(crc32cInit(), buffer, 1);
+    crc32c(crc32cInit(), buffer, 4096);
+    // counted in a thread of its own, then added to the others when it exits
+    std::thread other([] { crc32c(crc32cInit(), buffer, 3); });
+    other.join();
+    // a thread_local destroyed after the counters of its thread still counts
+    std::thread exiting([] {
+        static thread_local CRC32CAtThreadExit atExit;
+        (void) atExit;
+        crc32c(crc32cInit(), buffer, 2);
+    });
+    exiting.join();
+    CRC32CKernelStats after = kernelStats(name);
+    EXPECT_EQ(6, after.calls - before.calls);
+    EXPECT_EQ(4107, after.bytes - before.bytes);
+    EXPECT_EQ(1, after.buckets[0] - before.buckets[0]);
+    EXPECT_EQ(1, after.buckets[1] - before.buckets[1]);
+    EXPECT_EQ(2, after.buckets[2] - before.buckets[2]);
+    EXPECT_EQ(1, after.buckets[3] - before.buckets[3]);
+    EXPECT_EQ(1, after.buckets[13] - before.buckets[13]);
+
+    // off again: crc32c calls the kernel directly and nothing is counted
+    crc32cEnableStats(false);
+    EXPECT_EQ(kernel, crc32c);
+    crc32c(crc32cInit(), buffer, 1);
+    EXPECT_EQ(after.calls, kernelStats(name).calls);
+}
+
+TEST(CRC32C, Registry) {
+    size_t count;
+    const CRC32CKernel* kernels = crc32cKernels(&count);
+    for (size_t i = 0; i < count; ++i) {
+        EXPECT_EQ(&kernels[i], crc32cFindKernel(kernels[i].name));
+        EXPECT_TRUE(kernels[i].minLength <= kernels[i].maxLength);
+    }
+    EXPECT_TRUE(crc32cFindKernel("crc32cNoSuchKernel") == NULL);
+    // the portable kernels run everywhere, and so does what the dispatcher picks
+    EXPECT_TRUE(crc32cKernelUsable(*crc32cFindKernel("crc32cSarwate")));
+    EXPECT_TRUE(crc32cKernelUsable(*crc32cFindKernel(crc32cDispatch().kernel)));
+
+    EXPECT_TRUE(crc32cForceKernel("crc32cSlicingBy8"));
+    EXPECT_EQ(crc32cSlicingBy8, crc32c);
+    EXPECT_FALSE(crc32cForceKernel("crc32cNoSuchKernel"));
+    EXPECT_EQ(crc32cSlicingBy8, crc32c);
+    // back to detection on the next call
+    EXPECT_TRUE(crc32cForceKernel(NULL));
+    crc32c(crc32cInit(), NULL, 0);
+    EXPECT_EQ(detectBestCRC32C(), crc32c);
+
+    setenv("CRC32C_KERNEL", "crc32cSarwate", 1);
+    CRC32CDispatch dispatch = crc32cDispatch();
+    EXPECT_TRUE(dispatch.forced);
+    EXPECT_EQ(crc32cSarwate, dispatch.function);
+    // unknown names are ignored
+    setenv("CRC32C_KERNEL", "crc32cNoSuchKernel", 1);
+    EXPECT_FALSE(crc32cDispatch().forced);
+    unsetenv("CRC32C_KERNEL");
+}
+
+// The kernels of the library this processor can run, in the order of the registry
+static std::vector<CRC32CKernel> usableKernels() {
+    std::vector<CRC32CKernel> usable;
+    size_t count;
+    const CRC32CKernel* kernels = crc32cKernels(&count);
+    for (size_t i = 0; i < count; ++i) {
+        if (crc32cKernelUsable(kernels[i])) {
+            usable.push_back(kernels[i]);
         }
     }
-    return numFunctions;
+    return usable;
 }
-static const size_t NUM_VALID_FUNCTIONS = numValidFunctions();
+static const std::vector<CRC32CKernel> FNINFO = usableKernels();
+static const size_t NUM_VALID_FUNCTIONS = FNINFO.size();
 
-static bool check(const CRC32CFunctionInfo& fninfo, const void* data, size_t length, uint32_t value) {
-    uint32_t crc = fninfo.crcfn(crc32cInit(), data, length);
+static bool check(const CRC32CKernel& fninfo, const void* data, size_t length, uint32_t value) {
+    uint32_t crc = fninfo.function(crc32cInit(), data, length);
     crc = crc32cFinish(crc);
     if (crc != value) {
         printf("Function %s failed; expected: 0x%08x actual: 0x%08x. ", fninfo.name, value, crc);
@@ -117,6 +211,169 @@ TEST(CRC32C, KnownValues) {
     }
 }
 
+TEST(CRC32C, LongBuffers) {
+    // Lengths around the block sizes of the multi lane kernels
+    static const size_t LENGTHS[] = {
+        3 * 1024, 3 * 1024 + 24, 4096, 24 * 1024 + 7, 65536, 96 * 1024, 96 * 1024 + 8, 300001
+    };
+    static const size_t MAX_LENGTH = 300001;
+    char* buffer = new char[MAX_LENGTH + 1];
+    for (size_t i = 0; i < MAX_LENGTH + 1; i++) {
+        buffer[i] = (char) (i * 7 + (i >> 8));
+    }
+
+    for (size_t j = 0; j < sizeof(LENGTHS)/sizeof(*LENGTHS); ++j) {
+        for (int offset = 0; offset < 2; ++offset) {
+            size_t length = LENGTHS[j] - offset;
+            uint32_t expected = crc32cFinish(crc32cSlicingBy8(crc32cInit(), buffer + offset, length));
+            for (int i = 0; i < NUM_VALID_FUNCTIONS; ++i) {
+                EXPECT_TRUE(check(FNINFO[i], buffer + offset, length, expected));
+            }
+        }
+    }
+    delete[] buffer;
+}
+
+template <size_t N>
+static bool checkFixed(const char* buffer) {
+    bool ok = true;
+    for (int offset = 0; offset < 2; ++offset) {
+        uint32_t expected = crc32cSlicingBy8(crc32cInit(), buffer + offset, N);
+        uint32_t crc = crc32cFixed<N>(crc32cInit(), buffer + offset);
+        if (crc != expected) {
+            printf("Function crc32cFixed<%d> failed; expected: 0x%08x actual: 0x%08x offset %d\n",
+                    (int) N, expected, crc, offset);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+TEST(CRC32C, Stream) {
+    // The prefetch distance and hint must not change the crc, also for a distance past the end
+    static const size_t LENGTH = 5 * 3 * 4096 + 1001;
+    char* buffer = new char[LENGTH];
+    for (size_t i = 0; i < LENGTH; i++) {
+        buffer[i] = (char) (i * 11 + (i >> 10));
+    }
+    uint32_t expected = crc32cSlicingBy8(crc32cInit(), buffer + 3, LENGTH - 3);
+    static const size_t DISTANCES[] = { 0, 512, 64 * 1024 };
+    for (size_t i = 0; i < sizeof(DISTANCES)/sizeof(*DISTANCES); ++i) {
+        EXPECT_EQ(expected, crc32cIntelCStream(crc32cInit(), buffer + 3, LENGTH - 3, DISTANCES[i], false));
+        EXPECT_EQ(expected, crc32cIntelCStream(crc32cInit(), buffer + 3, LENGTH - 3, DISTANCES[i], true));
+    }
+    delete[] buffer;
+}
+
+TEST(CRC32C, Sectors) {
+    // Whole word sectors go through the lanes, the others and short last sectors through crc32cIntelC
+    static const size_t SECTOR_SIZES[] = { 8, 512, 520, 4096, 513, 100 };
+    static const size_t LENGTH = 9 * 4096 + 300;
+    char* buffer = new char[LENGTH];
+    uint32_t* out = new uint32_t[LENGTH / 8 + 1];
+    for (size_t i = 0; i < LENGTH; i++) {
+        buffer[i] = (char) (i * 13 + (i >> 9));
+    }
+
+    for (size_t j = 0; j < sizeof(SECTOR_SIZES)/sizeof(*SECTOR_SIZES); ++j) {
+        size_t sectorSize = SECTOR_SIZES[j];
+        const size_t lengths[] = { 0, sectorSize - 1, 4 * sectorSize, 9 * sectorSize + 5, LENGTH };
+        for (size_t k = 0; k < sizeof(lengths)/sizeof(*lengths); ++k) {
+            size_t length = lengths[k];
+            size_t sectors = crc32cSectors(buffer, length, sectorSize, out);
+            EXPECT_EQ((length + sectorSize - 1) / sectorSize, sectors);
+            for (size_t i = 0; i < sectors; ++i) {
+                size_t sectorLength = length - i * sectorSize < sectorSize ? length - i * sectorSize : sectorSize;
+                EXPECT_EQ(crc32cFinish(crc32cSlicingBy8(crc32cInit(), buffer + i * sectorSize, sectorLength)), out[i]);
+            }
+        }
+    }
+
+    // no sectors, and out is not written
+    out[0] = 0x12345678;
+    EXPECT_EQ(0, crc32cSectors(buffer, LENGTH, 0, out));
+    EXPECT_EQ(0x12345678, out[0]);
+    delete[] out;
+    delete[] buffer;
+}
+
+TEST(CRC32C, Padded) {
+    static const size_t MAX_LENGTH = 3 * 4096 + 100;
+    char* buffer = (char*) crc32cPaddedAlloc(MAX_LENGTH);
+    for (size_t i = 0; i < MAX_LENGTH; i++) {
+        buffer[i] = (char) (i * 7 + (i >> 8));
+    }
+    // The padding must not change the crc
+    memset(buffer + MAX_LENGTH, 0xa5, CRC32C_PADDING);
+
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t length = 0; length <= MAX_LENGTH - offset; length += (length < 1100 ? 1 : 97)) {
+            uint32_t expected = crc32cSlicingBy8(crc32cInit(), buffer + offset, length);
+            EXPECT_EQ(expected, crc32cPadded(crc32cInit(), buffer + offset, length));
+        }
+        // the data runs right up to the padding
+        size_t length = MAX_LENGTH - offset;
+        EXPECT_EQ(crc32cSlicingBy8(crc32cInit(), buffer + offset, length),
+                crc32cPadded(crc32cInit(), buffer + offset, length));
+    }
+    crc32cPaddedFree(buffer);
+}
+
+TEST(CRC32C, Fixed) {
+    static char buffer[65536 + 1];
+    for (int i = 0; i < sizeof(buffer); i++) {
+        buffer[i] = (char) (i * 31 + (i >> 9));
+    }
+    EXPECT_TRUE(checkFixed<256>(buffer));
+    EXPECT_TRUE(checkFixed<512>(buffer));
+    EXPECT_TRUE(checkFixed<1024>(buffer));
+    EXPECT_TRUE(checkFixed<2048>(buffer));
+    EXPECT_TRUE(checkFixed<4096>(buffer));
+    EXPECT_TRUE(checkFixed<8192>(buffer));
+    EXPECT_TRUE(checkFixed<16384>(buffer));
+    EXPECT_TRUE(checkFixed<32768>(buffer));
+    EXPECT_TRUE(checkFixed<65536>(buffer));
+}
+
+// Compile time checks: the check value of CRC32-C and use as a template argument
+static_assert(crc32cLiteral("123456789") == 0xE3069283, "crc32cLiteral check value");
+static_assert(crc32cLiteral("") == 0, "crc32cLiteral of nothing");
+
+template <uint32_t CRC>
+struct ConstCRC {
+    static const uint32_t value = CRC;
+};
+
+static int constSwitch(const char* tag, size_t length) {
+    switch (crc32cFinish(crc32cSarwate(crc32cInit(), tag, length))) {
+        case crc32cLiteral("header"):
+            return 1;
+        case crc32cLiteral("schema"):
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+TEST(CRC32C, Constexpr) {
+    EXPECT_EQ(0xE3069283, ConstCRC<crc32cLiteral("123456789")>::value);
+    EXPECT_EQ(1, constSwitch("header", 6));
+    EXPECT_EQ(2, constSwitch("schema", 6));
+    EXPECT_EQ(0, constSwitch("schemas", 7));
+    static_assert(crc32cMultiply(crc32cXPow(97), crc32cXPowInverse(97)) == crc32cXPow(0), "x^-n is the inverse of x^n");
+
+    // Cross check with crc32cSarwate for all lengths and a continued crc
+    char data[512];
+    for (int i = 0; i < sizeof(data); i++) {
+        data[i] = (char) (i * 13);
+    }
+    for (int i = 0; i < sizeof(data); i++) {
+        EXPECT_EQ(crc32cSarwate(crc32cInit(), data, i), crc32cConst(crc32cInit(), data, i));
+    }
+    uint32_t crc = crc32cConst(crc32cInit(), data, 100);
+    EXPECT_EQ(crc32cSarwate(crc32cInit(), data, 300), crc32cConst(crc, data + 100, 200));
+}
+
 /*
 static size_t misalignedLeadingBytes(const void* pointer, int alignment) {
     size_t misalignedBytes = (alignment - (intptr_t)pointer) & (alignment - 1);
@@ -167,7 +424,7 @@ TEST(CRC32C, Alignment) {
 
         uint32_t crc = 0;
         for (int j = 0; j < NUM_VALID_FUNCTIONS; ++j) {
-            uint32_t crcTemp = FNINFO[j].crcfn(crc32cInit(), start, end - start);
+            uint32_t crcTemp = FNINFO[j].function(crc32cInit(), start, end - start);
             crcTemp = crc32cFinish(crcTemp);
             if (j == 0) {
                 crc = crcTemp;
@@ -3,8 +3,27 @@
 // FT addition here
 #include <time.h>
 #include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <cpuid.h>
+#include <elf.h>
+#include <errno.h>
+#include <link.h>
+#include <string.h>
+#include <spawn.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
 
 #include "logging/crc32c.h"
+#include "logging/crc32intelc.h"
 #include "logging/cycletimer.h"
 
 using namespace logging;
@@ -20,37 +39,28 @@ struct CRC32CFunctionInfo {
     const char* name;
 };
 
-#define MAKE_FN_STRUCT(x) { x, # x }
-static const CRC32CFunctionInfo FNINFO[] = {
-    MAKE_FN_STRUCT(crc32cSarwate),
-    MAKE_FN_STRUCT(crc32cSlicingBy4),
-    MAKE_FN_STRUCT(crc32cSlicingBy8),
-    MAKE_FN_STRUCT(crc32cHardware32),
-#ifdef __LP64__
-    MAKE_FN_STRUCT(crc32cHardware64),
-    MAKE_FN_STRUCT(crc32cIntelAsm),
-#endif
-    MAKE_FN_STRUCT(crc32cAdler),
-    MAKE_FN_STRUCT(crc32cIntelC),
-};
-#undef MAKE_FN_STRUCT
-
-static size_t numValidFunctions() {
-    size_t numFunctions = sizeof(FNINFO)/sizeof(*FNINFO);
-    bool hasHardware = (detectBestCRC32C() != crc32cSlicingBy8);
-    if (!hasHardware) {
-        while (FNINFO[numFunctions-1].crcfn == crc32cHardware32 ||
-                FNINFO[numFunctions-1].crcfn == crc32cHardware64) {
-            numFunctions -= 1;
+// The kernels of the library this processor can run, in the order of the registry
+static std::vector<CRC32CFunctionInfo> usableFunctions() {
+    std::vector<CRC32CFunctionInfo> usable;
+    size_t count;
+    const CRC32CKernel* kernels = crc32cKernels(&count);
+    for (size_t i = 0; i < count; ++i) {
+        if (crc32cKernelUsable(kernels[i])) {
+            usable.push_back({ kernels[i].function, kernels[i].name });
         }
     }
-    return numFunctions;
+    return usable;
 }
-static const size_t NUM_VALID_FUNCTIONS = numValidFunctions();
+static const std::vector<CRC32CFunctionInfo> FNINFO = usableFunctions();
+static const size_t NUM_VALID_FUNCTIONS = FNINFO.size();
 
 
+// The arguments after the mode, NULL terminated, and the exit status a mode can set.
+static char** modeArguments;
+static int modeStatus = 0;
+
 static const int DATA_LENGTHS[] = {
-    16, 64, 128, 192, 256, 288, 512, 1024, 1032, 4096, 8192
+    16, 64, 128, 192, 256, 288, 512, 768, 1024, 1032, 3072, 4096, 8192, 16384, 65536
 };
 
 // FT timing function copies from crc32
@@ -61,6 +71,13 @@ static double seconds()
   return now.tv_sec + now.tv_nsec / 1000000000.0;
 }
 
+static int64_t nanoseconds()
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
 static int cmpDouble(const void *p1, const void *p2) {
     if(*(double *)p1 > *(double *)p2) return 1;
     if(*(double *)p1 == *(double *)p2) return 0;
@@ -68,12 +85,12 @@ static int cmpDouble(const void *p1, const void *p2) {
 }
 
 
-void runTest(const CRC32CFunctionInfo& fninfo, const char* buffer, int length, bool aligned) {
+// MiB/sec of each of TRIALS runs over BUFFER_MAX bytes, sorted.
+static void throughputTrials(const CRC32CFunctionInfo& fninfo, const char* buffer, int length,
+        double mibs[TRIALS]) {
     int iterations = BUFFER_MAX / length;
     double startTime, duration;
     double runTimes[TRIALS];
-    
-    printf("%-16s\t%s\t%d", fninfo.name, aligned ? "true" : "false", length);
 
     for (int j = 0; j < TRIALS; ++j) {
         uint32_t crc = 0;
@@ -96,11 +113,21 @@ void runTest(const CRC32CFunctionInfo& fninfo, const char* buffer, int length, b
 
     }
     qsort(runTimes, TRIALS, sizeof(double), cmpDouble);
+    for (int j = 0; j < TRIALS; ++j) {
+        mibs[j] = 128.0 / runTimes[TRIALS - 1 - j];
+    }
+}
+
+void runTest(const CRC32CFunctionInfo& fninfo, const char* buffer, int length, bool aligned) {
+    double mibs[TRIALS];
+
+    printf("%-16s\t%s\t%d", fninfo.name, aligned ? "true" : "false", length);
+    throughputTrials(fninfo, buffer, length, mibs);
 // FT calculates the median value when TRIALS is an odd number    
-    printf("\t%.3f\n", 128.0 / runTimes[(TRIALS + 1) / 2 - 1]);
+    printf("\t%.3f\n", mibs[(TRIALS + 1) / 2 - 1]);
 }
 
-int main() {
+static void runThroughput() {
     char* buffer = new char[BUFFER_MAX + ALIGNMENT];
     char* aligned_buffer = (char*) (((intptr_t) buffer + (ALIGNMENT-1)) & ~(ALIGNMENT-1));
     assert(aligned_buffer + BUFFER_MAX <= buffer + BUFFER_MAX + ALIGNMENT);
@@ -128,5 +155,1234 @@ int main() {
     }
 
     delete[] buffer;
+}
+
+#if defined(__clang__)
+#define CRC32C_COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#define CRC32C_COMPILER "gcc " __VERSION__
+#else
+#define CRC32C_COMPILER "unknown"
+#endif
+
+// Set by the Makefile to the flags this file was compiled with.
+#ifndef CRC32C_BUILD_FLAGS
+#define CRC32C_BUILD_FLAGS "unknown"
+#endif
+
+// The cpuid brand string, like "Intel(R) Xeon(R) Platinum 8592+".
+static std::string cpuBrand() {
+    unsigned regs[12];
+    if (__get_cpuid_max(0x80000000, NULL) < 0x80000004) {
+        return "unknown";
+    }
+    for (unsigned i = 0; i < 3; ++i) {
+        __get_cpuid(0x80000002 + i, &regs[4 * i], &regs[4 * i + 1], &regs[4 * i + 2], &regs[4 * i + 3]);
+    }
+    std::string brand((const char*) regs, sizeof(regs));
+    brand = brand.substr(0, brand.find('\0'));
+    size_t first = brand.find_first_not_of(' ');
+    size_t last = brand.find_last_not_of(' ');
+    return first == std::string::npos ? "unknown" : brand.substr(first, last - first + 1);
+}
+
+// The instruction set extensions of this processor the kernels use.
+static std::vector<const char*> cpuFlags() {
+    unsigned isa = crc32cSupportedISA();
+    std::vector<const char*> flags;
+    if (isa & CRC32C_ISA_SSE42) {
+        flags.push_back("sse4.2");
+    }
+    if (isa & CRC32C_ISA_PCLMUL) {
+        flags.push_back("pclmul");
+    }
+    if (isa & CRC32C_ISA_AVX512) {
+        flags.push_back("avx512f");
+        flags.push_back("avx512vl");
+        flags.push_back("vpclmulqdq");
+    }
+    return flags;
+}
+
+struct ThroughputResult {
+    std::string function;
+    bool aligned;
+    int bytes;
+    std::vector<double> mibs;   // MiB/sec of each trial, sorted
+
+    double median() const {
+        return mibs[(mibs.size() + 1) / 2 - 1];
+    }
+};
+
+/* Runs the throughput trials of each kernel of FNINFO named in results at its length and
+   alignment. Kernels this machine cannot run are left without trials. */
+static void measureThroughput(std::vector<ThroughputResult>& results) {
+    int maxLength = 0;
+    for (const ThroughputResult& result : results) {
+        maxLength = std::max(maxLength, result.bytes);
+    }
+    // runTest checksums the length bytes after the first length, one more when misaligned
+    char* buffer = new char[2 * maxLength + 1 + ALIGNMENT];
+    char* aligned_buffer = (char*) (((intptr_t) buffer + (ALIGNMENT-1)) & ~(ALIGNMENT-1));
+    for (int i = 0; i < 2 * maxLength + 1; ++i) {
+        aligned_buffer[i] = (char) i;
+    }
+
+    for (ThroughputResult& result : results) {
+        for (size_t fnIndex = 0; fnIndex < NUM_VALID_FUNCTIONS; ++fnIndex) {
+            if (result.function == FNINFO[fnIndex].name) {
+                double mibs[TRIALS];
+                throughputTrials(FNINFO[fnIndex], aligned_buffer + !result.aligned, result.bytes, mibs);
+                result.mibs.assign(mibs, mibs + TRIALS);
+            }
+        }
+    }
+
+    delete[] buffer;
+}
+
+// The runs of the throughput mode, measured.
+static std::vector<ThroughputResult> throughputResults() {
+    std::vector<ThroughputResult> results;
+    for (size_t fnIndex = 0; fnIndex < NUM_VALID_FUNCTIONS; ++fnIndex) {
+        for (int aligned = 1; aligned >= 0; --aligned) {
+            for (int length : DATA_LENGTHS) {
+                results.push_back({ FNINFO[fnIndex].name, aligned != 0, length - !aligned, {} });
+            }
+        }
+    }
+    measureThroughput(results);
+    return results;
+}
+
+static void printJsonString(const std::string& value) {
+    printf("\"");
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if ((unsigned char) c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            printf("%c", c);
+        }
+    }
+    printf("\"");
+}
+
+/* The throughput mode as CSV: the machine and the build on # lines, then one line per kernel,
+   alignment and length with the median and each trial. The compare mode reads this back. */
+static void runCsv() {
+    CRC32CDispatch dispatch = crc32cDispatch();
+    printf("# cpu: %s\n", cpuBrand().c_str());
+    printf("# cpuid: %s family 0x%x model 0x%x\n", dispatch.vendor, dispatch.family, dispatch.model);
+    printf("# flags:");
+    for (const char* flag : cpuFlags()) {
+        printf(" %s", flag);
+    }
+    printf("\n# kernel: %s\n", dispatch.kernel);
+    printf("# compiler: %s\n", CRC32C_COMPILER);
+    printf("# cxxflags: %s\n", CRC32C_BUILD_FLAGS);
+    printf("function,aligned,bytes,median");
+    for (int j = 0; j < TRIALS; ++j) {
+        printf(",trial%d", j + 1);
+    }
+    printf("\n");
+    fflush(stdout);
+
+    for (const ThroughputResult& result : throughputResults()) {
+        printf("%s,%s,%d,%.3f", result.function.c_str(), result.aligned ? "true" : "false",
+                result.bytes, result.median());
+        for (double mibs : result.mibs) {
+            printf(",%.3f", mibs);
+        }
+        printf("\n");
+    }
+}
+
+// The throughput mode as a JSON object, with the same data as runCsv.
+static void runJson() {
+    std::vector<ThroughputResult> results = throughputResults();
+    CRC32CDispatch dispatch = crc32cDispatch();
+
+    printf("{\n  \"cpu\": ");
+    printJsonString(cpuBrand());
+    printf(",\n  \"vendor\": ");
+    printJsonString(dispatch.vendor);
+    printf(",\n  \"family\": %u,\n  \"model\": %u,\n  \"flags\": [", dispatch.family, dispatch.model);
+    std::vector<const char*> flags = cpuFlags();
+    for (size_t i = 0; i < flags.size(); ++i) {
+        printf(i == 0 ? "" : ", ");
+        printJsonString(flags[i]);
+    }
+    printf("],\n  \"kernel\": ");
+    printJsonString(dispatch.kernel);
+    printf(",\n  \"compiler\": ");
+    printJsonString(CRC32C_COMPILER);
+    printf(",\n  \"cxxflags\": ");
+    printJsonString(CRC32C_BUILD_FLAGS);
+    printf(",\n  \"unit\": \"MiB/sec\",\n  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        printf("    {\"function\": ");
+        printJsonString(results[i].function);
+        printf(", \"aligned\": %s, \"bytes\": %d, \"median\": %.3f, \"trials\": [",
+                results[i].aligned ? "true" : "false", results[i].bytes, results[i].median());
+        for (size_t j = 0; j < results[i].mibs.size(); ++j) {
+            printf("%s%.3f", j == 0 ? "" : ", ", results[i].mibs[j]);
+        }
+        printf("]}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+// The lines of a CSV file written by runCsv, with the trials sorted; false if it cannot be read.
+static bool readBaseline(const char* path, std::vector<ThroughputResult>& baseline) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    char* line = NULL;
+    size_t capacity = 0;
+    while (getline(&line, &capacity, file) >= 0) {
+        char function[128];
+        char aligned[8];
+        int bytes;
+        int offset;
+        if (line[0] == '#' || sscanf(line, "%127[^,],%7[^,],%d,%n", function, aligned, &bytes, &offset) != 3) {
+            continue;   // the machine, the build and the header
+        }
+        ThroughputResult result = { function, strcmp(aligned, "true") == 0, bytes, {} };
+        // the median, then the trials
+        char* next = line + offset;
+        strtod(next, &next);
+        while (*next == ',') {
+            result.mibs.push_back(strtod(next + 1, &next));
+        }
+        if (result.mibs.empty() || bytes <= 0) {
+            fprintf(stderr, "%s: cannot parse %s", path, line);
+            continue;
+        }
+        std::sort(result.mibs.begin(), result.mibs.end());
+        baseline.push_back(result);
+    }
+    free(line);
+    fclose(file);
+    return true;
+}
+
+// Default drop of the median throughput, in percent, that the compare mode reports.
+static const double COMPARE_THRESHOLD = 5.0;
+
+/* Reruns each kernel, alignment and length of a CSV baseline from runCsv and compares the
+   medians. A drop by more than the threshold is a regression only if every trial of this run
+   is slower than every trial of the baseline (a one-sided Mann-Whitney U of 0, p < 0.01 for
+   5 and 5 trials); otherwise it is reported as noise. Exits with 1 if there is a regression.
+   Arguments: the baseline, and optionally the threshold in percent. */
+static void runCompare() {
+    if (modeArguments[0] == NULL) {
+        fprintf(stderr, "usage: crc32cbench compare baseline.csv [threshold%%]\n");
+        modeStatus = 2;
+        return;
+    }
+    double threshold = modeArguments[1] != NULL ? atof(modeArguments[1]) : COMPARE_THRESHOLD;
+    std::vector<ThroughputResult> baseline;
+    if (!readBaseline(modeArguments[0], baseline)) {
+        modeStatus = 2;
+        return;
+    }
+    std::vector<ThroughputResult> current = baseline;
+    for (ThroughputResult& result : current) {
+        result.mibs.clear();
+    }
+    measureThroughput(current);
+
+    int regressions = 0;
+    printf("function\t\taligned\tbytes\tbaseline\tcurrent\tchange\tresult\n");
+    for (size_t i = 0; i < baseline.size(); ++i) {
+        printf("%-16s\t%s\t%d\t%.3f", baseline[i].function.c_str(), baseline[i].aligned ? "true" : "false",
+                baseline[i].bytes, baseline[i].median());
+        if (current[i].mibs.empty()) {
+            printf("\t-\t-\tmissing\n");
+            continue;
+        }
+        double change = (current[i].median() / baseline[i].median() - 1) * 100;
+        const char* verdict = "ok";
+        if (change < -threshold) {
+            if (current[i].mibs.back() < baseline[i].mibs.front()) {
+                verdict = "REGRESSION";
+                ++regressions;
+            } else {
+                verdict = "noise";
+            }
+        }
+        printf("\t%.3f\t%+.1f%%\t%s\n", current[i].median(), change, verdict);
+    }
+    printf("# %d regressions of more than %.1f%%\n", regressions, threshold);
+    if (regressions > 0) {
+        modeStatus = 1;
+    }
+}
+
+// Number of CombineCRC calls timed per lane count.
+static const int COMBINES = 16 * 1000 * 1000;
+
+/* Time the combine step that ends each block of the multi lane kernels. The combines are
+   chained: the result of one is the first lane of the next, as in the kernel, so this is the
+   latency that each block adds on top of its crc32 instructions. The only code of this file
+   that is compiled for SSE 4.2 and pclmulqdq; the rest runs on any x86. */
+template <unsigned Lanes>
+__attribute__((target("sse4.2,pclmul")))
+static void runCombine() {
+    static constexpr CRC32CShiftTable<(Lanes - 1) * 128> K {};
+    static const uint64_t last = 0x0123456789abcdefULL;
+    CRC_NATIVE crc[Lanes];
+    for (unsigned i = 0; i < Lanes; ++i) {
+        crc[i] = 0x9e3779b9 * (i + 1);
+    }
+
+    double startTime = seconds();
+    for (int i = 0; i < COMBINES; ++i) {
+        crc[0] = CombineCRC<Lanes>(crc, &last, 128, K.k);
+    }
+    double duration = seconds() - startTime;
+
+    // Print the crc so the loop can not be optimized away
+    printf("%u\t%d\t%.2f\t(%08x)\n", Lanes, (int) sizeof(void*) * 8,
+            duration * 1e9 / COMBINES, (uint32_t) crc[0]);
+}
+
+static void runCombines() {
+    unsigned isa = crc32cSupportedISA();
+    if (!(isa & CRC32C_ISA_SSE42) || !(isa & CRC32C_ISA_PCLMUL)) {
+        fprintf(stderr, "combine needs the crc32 and pclmulqdq instructions\n");
+        return;
+    }
+    printf("lanes\tbits\tns/combine\n");
+    runCombine<2>();
+    runCombine<3>();
+    runCombine<4>();
+    runCombine<5>();
+    runCombine<6>();
+    runCombine<7>();
+    runCombine<8>();
+}
+
+// Bytes written between calls to push the crc tables and the data out of the caches.
+static const int EVICT_SIZE = 16 * 1024 * 1024;
+static const int CALL_TRIALS = 15;
+
+static const int CACHE_LENGTHS[] = {
+    256, 1024, 4096, 32768
+};
+
+static char* evictBuffer;
+
+static void evictCaches() {
+    for (int i = 0; i < EVICT_SIZE; i += 64) {
+        evictBuffer[i]++;
+    }
+}
+
+/* Median time of a single call in ns. With flush, something is pushed out of the caches before
+   each call, which is what a checksum in between other work sees. */
+static double medianCallTime(CRC32CFunctionPtr crcfn, const char* data, int length, void (*flush)()) {
+    double callTimes[CALL_TRIALS];
+    uint32_t crc = 0;
+    crc ^= crcfn(crc32cInit(), data, length);    // warm up
+    for (int j = 0; j < CALL_TRIALS; ++j) {
+        if (flush != NULL) {
+            flush();
+        }
+        int64_t startTime = nanoseconds();
+        crc ^= crcfn(crc32cInit(), data, length);
+        callTimes[j] = (double) (nanoseconds() - startTime);
+    }
+    qsort(callTimes, CALL_TRIALS, sizeof(double), cmpDouble);
+    if (crc == 0x12345678) printf(" ");     // keep the calls
+    return callTimes[(CALL_TRIALS + 1) / 2 - 1];
+}
+
+static void runCache() {
+    int maxLength = CACHE_LENGTHS[sizeof(CACHE_LENGTHS)/sizeof(*CACHE_LENGTHS) - 1];
+    char* data = new char[maxLength];
+    evictBuffer = new char[EVICT_SIZE];
+    for (int i = 0; i < maxLength; ++i) {
+        data[i] = (char) i;
+    }
+    memset(evictBuffer, 0, EVICT_SIZE);
+
+    printf("function\t\tbytes\thot ns\tcold ns\n");
+    for (size_t fnIndex = 0; fnIndex < NUM_VALID_FUNCTIONS; ++fnIndex) {
+        for (size_t lengthIndex = 0; lengthIndex < sizeof(CACHE_LENGTHS)/sizeof(*CACHE_LENGTHS);
+                ++lengthIndex) {
+            int length = CACHE_LENGTHS[lengthIndex];
+            double hot = medianCallTime(FNINFO[fnIndex].crcfn, data, length, NULL);
+            double cold = medianCallTime(FNINFO[fnIndex].crcfn, data, length, evictCaches);
+            printf("%-16s\t%d\t%.0f\t%.0f\n", FNINFO[fnIndex].name, length, hot, cold);
+        }
+    }
+
+    delete[] evictBuffer;
+    delete[] data;
+}
+
+/* Runs through 2048 cache lines (128 KiB) of code, one jump per line. This evicts the L1
+   instruction cache and the decoded uop cache, but not the data the crc functions use. */
+extern "C" void polluteInstructionCache();
+asm(".text\n"
+    ".p2align 6\n"
+    ".globl polluteInstructionCache\n"
+    ".type polluteInstructionCache, @function\n"
+    "polluteInstructionCache:\n"
+    ".rept 2048\n"
+    "jmp 1f\n"
+    ".p2align 6\n"
+    "1:\n"
+    ".endr\n"
+    "ret\n"
+    ".size polluteInstructionCache, . - polluteInstructionCache\n");
+
+static const int ICACHE_LENGTHS[] = {
+    64, 256, 1024, 4096
+};
+
+/* Like the cache mode, but only the code is flushed: the time of a call whose kernel was pushed
+   out of the instruction cache by other code, with the data and tables still cached. */
+static void runICache() {
+    int maxLength = ICACHE_LENGTHS[sizeof(ICACHE_LENGTHS)/sizeof(*ICACHE_LENGTHS) - 1];
+    char* data = new char[maxLength];
+    for (int i = 0; i < maxLength; ++i) {
+        data[i] = (char) i;
+    }
+
+    printf("function\t\tbytes\thot ns\tcold code ns\n");
+    for (size_t fnIndex = 0; fnIndex < NUM_VALID_FUNCTIONS; ++fnIndex) {
+        for (size_t lengthIndex = 0; lengthIndex < sizeof(ICACHE_LENGTHS)/sizeof(*ICACHE_LENGTHS);
+                ++lengthIndex) {
+            int length = ICACHE_LENGTHS[lengthIndex];
+            double hot = medianCallTime(FNINFO[fnIndex].crcfn, data, length, NULL);
+            double cold = medianCallTime(FNINFO[fnIndex].crcfn, data, length, polluteInstructionCache);
+            printf("%-16s\t%d\t%.0f\t%.0f\n", FNINFO[fnIndex].name, length, hot, cold);
+        }
+    }
+
+    delete[] data;
+}
+
+struct FunctionSymbol {
+    uintptr_t address;
+    size_t size;
+};
+
+static int firstLoadBias(struct dl_phdr_info* info, size_t, void* bias) {
+    *(uintptr_t*) bias = info->dlpi_addr;
+    return 1;   // the first object is the executable
+}
+
+/* Reads the address and size of all functions from the symbol table of this executable. Returns
+   false if it has none, e.g. when it was stripped. */
+static bool readFunctionSymbols(std::vector<FunctionSymbol>& functions) {
+    FILE* file = fopen("/proc/self/exe", "rb");
+    if (file == NULL) {
+        return false;
+    }
+    std::vector<char> image;
+    char chunk[65536];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        image.insert(image.end(), chunk, chunk + read);
+    }
+    fclose(file);
+
+    const ElfW(Ehdr)* header = (const ElfW(Ehdr)*) image.data();
+    if (image.size() < sizeof(*header) || memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) {
+        return false;
+    }
+    uintptr_t bias = 0;
+    dl_iterate_phdr(firstLoadBias, &bias);
+
+    const ElfW(Shdr)* sections = (const ElfW(Shdr)*) (image.data() + header->e_shoff);
+    for (int i = 0; i < header->e_shnum; ++i) {
+        if (sections[i].sh_type != SHT_SYMTAB) {
+            continue;
+        }
+        const ElfW(Sym)* symbols = (const ElfW(Sym)*) (image.data() + sections[i].sh_offset);
+        size_t count = sections[i].sh_size / sizeof(ElfW(Sym));
+        // st_info is a byte in both ELF classes, ELF32_ST_TYPE works for either
+        for (size_t j = 0; j < count; ++j) {
+            if (ELF32_ST_TYPE(symbols[j].st_info) == STT_FUNC && symbols[j].st_size > 0) {
+                FunctionSymbol function = { bias + symbols[j].st_value, symbols[j].st_size };
+                functions.push_back(function);
+            }
+        }
+    }
+    return !functions.empty();
+}
+
+/* Bytes of code of the function at address. A function that is a single jump, like crc32cIntelC
+   to its template instance, is counted with the function it jumps to. */
+static size_t codeSize(const std::vector<FunctionSymbol>& functions, uintptr_t address) {
+    for (size_t i = 0; i < functions.size(); ++i) {
+        if (functions[i].address != address) {
+            continue;
+        }
+        const unsigned char* code = (const unsigned char*) address;
+        if (code[0] == 0xe9 && functions[i].size <= 16) {     // jmp rel32
+            int32_t offset;
+            memcpy(&offset, code + 1, sizeof(offset));
+            return functions[i].size + codeSize(functions, address + 5 + offset);
+        }
+        return functions[i].size;
+    }
     return 0;
 }
+
+/* Code size of each function, the instruction cache space a call takes. Inlined helpers count
+   with the function; called functions (crc32cIntelAsm calls crc_pcl) and tables do not. */
+static void runSize() {
+    std::vector<FunctionSymbol> functions;
+    if (!readFunctionSymbols(functions)) {
+        printf("no symbol table\n");
+        return;
+    }
+
+    // all kernels, also those this processor cannot run
+    size_t count;
+    const CRC32CKernel* kernels = crc32cKernels(&count);
+    printf("function\t\tcode bytes\n");
+    for (size_t i = 0; i < count; ++i) {
+        printf("%-16s\t%zu\n", kernels[i].name, codeSize(functions, (uintptr_t) kernels[i].function));
+    }
+}
+
+// Sizes of the other working set in the pressure mode, in KiB, from none to beyond L2.
+static const int PRESSURE_KIB[] = {
+    0, 16, 32, 64, 256, 1024, 4096
+};
+static const int PRESSURE_LENGTHS[] = {
+    64, 512
+};
+
+static const CRC32CFunctionInfo PRESSURE_FNINFO[] = {
+    { crc32cNibble, "crc32cNibble" },
+    { crc32cNibblePair, "crc32cNibblePair" },
+    { crc32cSarwate, "crc32cSarwate" },
+    { crc32cSlicingBy4, "crc32cSlicingBy4" },
+    { crc32cSlicingBy8, "crc32cSlicingBy8" },
+    { crc32cSlicingBy16, "crc32cSlicingBy16" },
+    { crc32cBraid, "crc32cBraid" },
+};
+
+static char* pressureBuffer;
+static int pressureBytes;
+
+// Touch every cache line of the other working set, as the application would between checksums.
+static void applyPressure() {
+    for (int i = 0; i < pressureBytes; i += 64) {
+        pressureBuffer[i]++;
+    }
+}
+
+/* ns per call of the table driven kernels while the application has a working set of its own.
+   Unlike the cache mode the same working set is touched every time, so it competes with the
+   tables for L1 and L2 the way a hot loop around the checksum does. */
+static void runPressure() {
+    int maxPressure = PRESSURE_KIB[sizeof(PRESSURE_KIB)/sizeof(*PRESSURE_KIB) - 1] * 1024;
+    pressureBuffer = new char[maxPressure];
+    memset(pressureBuffer, 0, maxPressure);
+    char data[512];
+    for (int i = 0; i < (int) sizeof(data); ++i) {
+        data[i] = (char) i;
+    }
+
+    printf("function\t\tbytes");
+    for (size_t i = 0; i < sizeof(PRESSURE_KIB)/sizeof(*PRESSURE_KIB); ++i) {
+        printf("\t%dK", PRESSURE_KIB[i]);
+    }
+    printf("\n");
+    for (size_t lengthIndex = 0; lengthIndex < sizeof(PRESSURE_LENGTHS)/sizeof(*PRESSURE_LENGTHS);
+            ++lengthIndex) {
+        for (size_t fnIndex = 0; fnIndex < sizeof(PRESSURE_FNINFO)/sizeof(*PRESSURE_FNINFO); ++fnIndex) {
+            printf("%-16s\t%d", PRESSURE_FNINFO[fnIndex].name, PRESSURE_LENGTHS[lengthIndex]);
+            for (size_t i = 0; i < sizeof(PRESSURE_KIB)/sizeof(*PRESSURE_KIB); ++i) {
+                pressureBytes = PRESSURE_KIB[i] * 1024;
+                printf("\t%.0f", medianCallTime(PRESSURE_FNINFO[fnIndex].crcfn, data,
+                        PRESSURE_LENGTHS[lengthIndex], applyPressure));
+            }
+            printf("\n");
+        }
+    }
+
+    delete[] pressureBuffer;
+}
+
+/* The fixed, sectors, padded, random and dram modes only compare crc32intelc.cc kernels, which
+   need SSE 4.2 and pclmulqdq. False, with a note, if this processor does not have them. */
+static bool hasIntelCInstructions(const char* mode) {
+    unsigned isa = crc32cSupportedISA();
+    if ((isa & CRC32C_ISA_SSE42) && (isa & CRC32C_ISA_PCLMUL)) {
+        return true;
+    }
+    fprintf(stderr, "%s needs the crc32 and pclmulqdq instructions, not supported on this processor\n",
+            mode);
+    return false;
+}
+
+// crc32cFixed<N> with the signature of the other functions; length must be N.
+template <size_t N>
+static uint32_t crc32cFixedFunction(uint32_t crc, const void* data, size_t) {
+    return crc32cFixed<N>(crc, data);
+}
+
+#define MAKE_FIXED_STRUCT(n) { { crc32cFixedFunction<n>, "crc32cFixed<" # n ">" }, n }
+static const struct {
+    CRC32CFunctionInfo fninfo;
+    int length;
+} FIXED_FNINFO[] = {
+    MAKE_FIXED_STRUCT(512),
+    MAKE_FIXED_STRUCT(4096),
+    MAKE_FIXED_STRUCT(65536),
+};
+#undef MAKE_FIXED_STRUCT
+
+static const CRC32CFunctionInfo RUNTIME_LENGTH_FNINFO[] = {
+#ifdef __LP64__
+    { crc32cHardware64, "crc32cHardware64" },
+#endif
+    { crc32cIntelC, "crc32cIntelC" },
+    { crc32cIntelCAdaptive, "crc32cIntelCAdaptive" },
+};
+
+/* crc32cFixed<N> against the runtime length kernels at the sizes it is made for. */
+static void runFixed() {
+    if (!hasIntelCInstructions("fixed")) {
+        return;
+    }
+    char* buffer = new char[2 * 65536];
+    for (int i = 0; i < 2 * 65536; ++i) {
+        buffer[i] = (char) i;
+    }
+
+    printf("function\t\taligned\tbytes\tMiB/sec\n");
+    for (size_t i = 0; i < sizeof(FIXED_FNINFO)/sizeof(*FIXED_FNINFO); ++i) {
+        int length = FIXED_FNINFO[i].length;
+        runTest(FIXED_FNINFO[i].fninfo, buffer, length, true);
+        for (size_t j = 0; j < sizeof(RUNTIME_LENGTH_FNINFO)/sizeof(*RUNTIME_LENGTH_FNINFO); ++j) {
+            runTest(RUNTIME_LENGTH_FNINFO[j], buffer, length, true);
+        }
+    }
+
+    delete[] buffer;
+}
+
+// Size of the buffer checksummed per call in the sectors mode, and the sector sizes.
+static const int SECTORS_BUFFER = 256 * 1024;
+static const int SECTORS_ITERATIONS = 2000;
+static const int SECTOR_SIZES[] = {
+    512, 4096
+};
+
+// What a caller without crc32cSectors does: one serial crc32cIntelC chain per sector.
+static size_t crc32cSectorsLoop(const void* data, size_t length, size_t sectorSize, uint32_t* out) {
+    const char* next = (const char*) data;
+    size_t sectors = length / sectorSize;
+    for (size_t i = 0; i < sectors; ++i) {
+        out[i] = crc32cFinish(crc32cIntelC(crc32cInit(), next + i * sectorSize, sectorSize));
+    }
+    return sectors;
+}
+
+static const struct {
+    size_t (*sectorsfn)(const void*, size_t, size_t, uint32_t*);
+    const char* name;
+} SECTORS_FNINFO[] = {
+    { crc32cSectors, "crc32cSectors" },
+    { crc32cSectorsLoop, "crc32cIntelC loop" },
+};
+
+/* crc32cSectors against a loop over the sectors, for a buffer of whole sectors. */
+static void runSectors() {
+    if (!hasIntelCInstructions("sectors")) {
+        return;
+    }
+    char* buffer = new char[SECTORS_BUFFER];
+    uint32_t* out = new uint32_t[SECTORS_BUFFER / SECTOR_SIZES[0]];
+    for (int i = 0; i < SECTORS_BUFFER; ++i) {
+        buffer[i] = (char) i;
+    }
+
+    printf("function\t\tsector\tMiB/sec\n");
+    for (size_t i = 0; i < sizeof(SECTOR_SIZES)/sizeof(*SECTOR_SIZES); ++i) {
+        for (size_t j = 0; j < sizeof(SECTORS_FNINFO)/sizeof(*SECTORS_FNINFO); ++j) {
+            double trialTimes[TRIALS];
+            for (int trial = 0; trial < TRIALS; ++trial) {
+                double start = seconds();
+                for (int k = 0; k < SECTORS_ITERATIONS; ++k) {
+                    SECTORS_FNINFO[j].sectorsfn(buffer, SECTORS_BUFFER, SECTOR_SIZES[i], out);
+                }
+                trialTimes[trial] = seconds() - start;
+            }
+            qsort(trialTimes, TRIALS, sizeof(double), cmpDouble);
+            double median = trialTimes[(TRIALS + 1) / 2 - 1];
+            printf("%-16s\t%d\t%.1f\n", SECTORS_FNINFO[j].name, SECTOR_SIZES[i],
+                    (double) SECTORS_BUFFER * SECTORS_ITERATIONS / median / 1024 / 1024);
+        }
+    }
+
+    delete[] out;
+    delete[] buffer;
+}
+
+// Number of lengths drawn per run of the random length modes, and the passes over them.
+static const int RANDOM_CALLS = 4096;
+static const int RANDOM_PASSES = 200;
+static const int RANDOM_MAX_LENGTHS[] = {
+    64, 256, 1024, 4096
+};
+
+/* Median ns per call over calls with the given lengths. Each call starts at a different offset
+   in data, so the predictor sees the lengths and alignments of real traffic, not one repeated
+   length. data must hold offsets[i] + lengths[i] bytes plus CRC32C_PADDING. */
+static double randomLengthsTime(CRC32CFunctionPtr crcfn, const char* data, const int* offsets,
+        const int* lengths, int count) {
+    double runTimes[TRIALS];
+    uint32_t crc = 0;
+    for (int j = 0; j < TRIALS; ++j) {
+        double startTime = seconds();
+        for (int pass = 0; pass < RANDOM_PASSES; ++pass) {
+            for (int i = 0; i < count; ++i) {
+                crc ^= crcfn(crc32cInit(), data + offsets[i], lengths[i]);
+            }
+        }
+        runTimes[j] = seconds() - startTime;
+    }
+    if (crc == 0x12345678) printf(" ");     // keep the calls
+    qsort(runTimes, TRIALS, sizeof(double), cmpDouble);
+    return runTimes[(TRIALS + 1) / 2 - 1] * 1e9 / RANDOM_PASSES / count;
+}
+
+static const CRC32CFunctionInfo PADDED_FNINFO[] = {
+    { crc32cPadded, "crc32cPadded" },
+#ifdef __LP64__
+    { crc32cHardware64, "crc32cHardware64" },
+#endif
+    { crc32cIntelC, "crc32cIntelC" },
+    { crc32cAdler, "crc32cAdler" },
+};
+
+/* crc32cPadded against the kernels that stay inside the buffer, on lengths drawn uniformly
+   from 0 to a maximum. */
+static void runPadded() {
+    if (!hasIntelCInstructions("padded")) {
+        return;
+    }
+    int maxLength = RANDOM_MAX_LENGTHS[sizeof(RANDOM_MAX_LENGTHS)/sizeof(*RANDOM_MAX_LENGTHS) - 1];
+    char* data = (char*) crc32cPaddedAlloc(maxLength + 8);
+    int* offsets = new int[RANDOM_CALLS];
+    int* lengths = new int[RANDOM_CALLS];
+    for (int i = 0; i < maxLength + 8; ++i) {
+        data[i] = (char) i;
+    }
+
+    srand(1);
+    printf("function\t\tmax bytes\tns/call\n");
+    for (size_t i = 0; i < sizeof(RANDOM_MAX_LENGTHS)/sizeof(*RANDOM_MAX_LENGTHS); ++i) {
+        for (int j = 0; j < RANDOM_CALLS; ++j) {
+            offsets[j] = rand() % 8;
+            lengths[j] = rand() % (RANDOM_MAX_LENGTHS[i] + 1);
+        }
+        for (size_t j = 0; j < sizeof(PADDED_FNINFO)/sizeof(*PADDED_FNINFO); ++j) {
+            printf("%-16s\t%d\t\t%.1f\n", PADDED_FNINFO[j].name, RANDOM_MAX_LENGTHS[i],
+                    randomLengthsTime(PADDED_FNINFO[j].crcfn, data, offsets, lengths, RANDOM_CALLS));
+        }
+    }
+
+    delete[] lengths;
+    delete[] offsets;
+    crc32cPaddedFree(data);
+}
+
+// Distributions of the random mode. Log-normal lengths are capped at RANDOM_LENGTH_CAP.
+static const int RANDOM_LENGTH_CAP = 65536;
+static const struct {
+    bool logNormal;
+    double a, b;    // uniform: 0 to a bytes; log-normal: median a bytes, sigma b
+    const char* name;
+} RANDOM_DISTRIBUTIONS[] = {
+    { false, 256, 0, "uniform 0-256" },
+    { false, 4096, 0, "uniform 0-4096" },
+    { true, 64, 1.0, "lognormal 64,1" },
+    { true, 512, 1.5, "lognormal 512,1.5" },
+};
+
+static const CRC32CFunctionInfo RANDOM_FNINFO[] = {
+    { crc32cIntelCLoop, "crc32cIntelCLoop" },
+    { crc32cPadded, "crc32cPadded" },
+    { crc32cIntelC, "crc32cIntelC" },
+#ifdef __LP64__
+    { crc32cHardware64, "crc32cHardware64" },
+#endif
+    { crc32cAdler, "crc32cAdler" },
+};
+
+/* ns per call on lengths drawn from a distribution, against the same calls all with the mean
+   length. The difference is mostly the cost of the length dependent branches mispredicting. */
+static void runRandom() {
+    if (!hasIntelCInstructions("random")) {
+        return;
+    }
+    char* data = (char*) crc32cPaddedAlloc(RANDOM_LENGTH_CAP + 8);
+    int* offsets = new int[RANDOM_CALLS];
+    int* lengths = new int[RANDOM_CALLS];
+    int* meanLengths = new int[RANDOM_CALLS];
+    for (int i = 0; i < RANDOM_LENGTH_CAP + 8; ++i) {
+        data[i] = (char) i;
+    }
+
+    std::mt19937 generator(1);
+    printf("function\t\tdistribution\t\tmean\tns/call\tfixed ns/call\n");
+    for (size_t i = 0; i < sizeof(RANDOM_DISTRIBUTIONS)/sizeof(*RANDOM_DISTRIBUTIONS); ++i) {
+        std::uniform_int_distribution<int> uniform(0, (int) RANDOM_DISTRIBUTIONS[i].a);
+        std::lognormal_distribution<double> logNormal(log(RANDOM_DISTRIBUTIONS[i].a),
+                RANDOM_DISTRIBUTIONS[i].b);
+        int64_t total = 0;
+        for (int j = 0; j < RANDOM_CALLS; ++j) {
+            offsets[j] = generator() % 8;
+            if (RANDOM_DISTRIBUTIONS[i].logNormal) {
+                double length = logNormal(generator);
+                lengths[j] = length < RANDOM_LENGTH_CAP ? (int) length : RANDOM_LENGTH_CAP;
+            } else {
+                lengths[j] = uniform(generator);
+            }
+            total += lengths[j];
+        }
+        int mean = (int) (total / RANDOM_CALLS);
+        for (int j = 0; j < RANDOM_CALLS; ++j) {
+            meanLengths[j] = mean;
+        }
+
+        for (size_t j = 0; j < sizeof(RANDOM_FNINFO)/sizeof(*RANDOM_FNINFO); ++j) {
+            double random = randomLengthsTime(RANDOM_FNINFO[j].crcfn, data, offsets, lengths, RANDOM_CALLS);
+            double fixed = randomLengthsTime(RANDOM_FNINFO[j].crcfn, data, offsets, meanLengths, RANDOM_CALLS);
+            printf("%-16s\t%-16s\t%d\t%.1f\t%.1f\n", RANDOM_FNINFO[j].name, RANDOM_DISTRIBUTIONS[i].name,
+                    mean, random, fixed);
+        }
+    }
+
+    delete[] meanLengths;
+    delete[] lengths;
+    delete[] offsets;
+    crc32cPaddedFree(data);
+}
+
+// Longest length of the stats mode, uniform from 0.
+static const int STATS_MAX_LENGTHS[] = {
+    16, 256, 4096
+};
+
+/* ns per call of crc32c with the usage counters off and on, then what the counters saw. */
+static void runStats() {
+    char* data = new char[4096 + 8];
+    int* offsets = new int[RANDOM_CALLS];
+    int* lengths = new int[RANDOM_CALLS];
+    for (int i = 0; i < 4096 + 8; ++i) {
+        data[i] = (char) i;
+    }
+
+    crc32c(crc32cInit(), data, 0);    // detect the kernel
+    std::mt19937 generator(1);
+    printf("kernel\t\t\tmax bytes\tns/call\twith stats\n");
+    for (size_t i = 0; i < sizeof(STATS_MAX_LENGTHS)/sizeof(*STATS_MAX_LENGTHS); ++i) {
+        std::uniform_int_distribution<int> uniform(0, STATS_MAX_LENGTHS[i]);
+        for (int j = 0; j < RANDOM_CALLS; ++j) {
+            offsets[j] = generator() % 8;
+            lengths[j] = uniform(generator);
+        }
+        crc32cEnableStats(false);
+        double off = randomLengthsTime(crc32c, data, offsets, lengths, RANDOM_CALLS);
+        crc32cEnableStats(true);
+        double on = randomLengthsTime(crc32c, data, offsets, lengths, RANDOM_CALLS);
+        printf("%-16s\t%d\t\t%.1f\t%.1f\n", crc32cDispatch().kernel, STATS_MAX_LENGTHS[i], off, on);
+    }
+    crc32cEnableStats(false);
+
+    CRC32CKernelStats stats[64];
+    size_t count = crc32cStatsSnapshot(stats, 64);
+    printf("\nkernel\t\t\tcalls\tbytes\tcalls by length: bucket b is < 2^b bytes\n");
+    for (size_t i = 0; i < count; ++i) {
+        printf("%-16s\t%llu\t%llu", stats[i].name, (unsigned long long) stats[i].calls,
+                (unsigned long long) stats[i].bytes);
+        for (size_t b = 0; b < CRC32C_STATS_BUCKETS; ++b) {
+            if (stats[i].buckets[b] != 0) {
+                printf("\t%zu:%llu", b, (unsigned long long) stats[i].buckets[b]);
+            }
+        }
+        printf("\n");
+    }
+
+    delete[] lengths;
+    delete[] offsets;
+    delete[] data;
+}
+
+// Working set of the dram mode, larger than the last level cache of current servers, and the
+// bytes per call.
+static const size_t DRAM_BUFFER = 1024 * 1024 * 1024;
+static const size_t DRAM_CALL_LENGTH = 1024 * 1024;
+static const int DRAM_TRIALS = 3;
+
+// crc32cIntelC with the signature of crc32cIntelCStream.
+static uint32_t crc32cIntelCNoPrefetch(uint32_t crc, const void* data, size_t length, size_t, bool) {
+    return crc32cIntelC(crc, data, length);
+}
+
+static const struct {
+    uint32_t (*crcfn)(uint32_t, const void*, size_t, size_t, bool);
+    const char* name;
+    size_t distance;
+    bool nontemporal;
+} DRAM_FNINFO[] = {
+    { crc32cIntelCNoPrefetch, "crc32cIntelC", 0, false },
+    { crc32cIntelCStream, "crc32cIntelCStream", 0, false },
+    { crc32cIntelCStream, "crc32cIntelCStream", 256, false },
+    { crc32cIntelCStream, "crc32cIntelCStream", 512, false },
+    { crc32cIntelCStream, "crc32cIntelCStream", 1024, false },
+    { crc32cIntelCStream, "crc32cIntelCStream", 2048, false },
+    { crc32cIntelCStream, "crc32cIntelCStream", 512, true },
+    { crc32cIntelCStream, "crc32cIntelCStream", 1024, true },
+};
+
+/* MiB/sec over a buffer too large to be cached, walked once per trial in calls of
+   DRAM_CALL_LENGTH, for a range of prefetch distances. */
+static void runDram() {
+    if (!hasIntelCInstructions("dram")) {
+        return;
+    }
+    char* buffer = new char[DRAM_BUFFER];
+    for (size_t i = 0; i < DRAM_BUFFER; ++i) {
+        buffer[i] = (char) i;
+    }
+
+    printf("function\t\tdistance\tnta\tMiB/sec\n");
+    for (size_t i = 0; i < sizeof(DRAM_FNINFO)/sizeof(*DRAM_FNINFO); ++i) {
+        double runTimes[DRAM_TRIALS];
+        uint32_t crc = 0;
+        for (int j = 0; j < DRAM_TRIALS; ++j) {
+            double startTime = seconds();
+            for (size_t offset = 0; offset < DRAM_BUFFER; offset += DRAM_CALL_LENGTH) {
+                crc ^= DRAM_FNINFO[i].crcfn(crc32cInit(), buffer + offset, DRAM_CALL_LENGTH,
+                        DRAM_FNINFO[i].distance, DRAM_FNINFO[i].nontemporal);
+            }
+            runTimes[j] = seconds() - startTime;
+        }
+        if (crc == 0x12345678) printf(" ");     // keep the calls
+        qsort(runTimes, DRAM_TRIALS, sizeof(double), cmpDouble);
+        printf("%-16s\t%zu\t\t%s\t%.0f\n", DRAM_FNINFO[i].name, DRAM_FNINFO[i].distance,
+                DRAM_FNINFO[i].nontemporal ? "yes" : "no",
+                DRAM_BUFFER / runTimes[(DRAM_TRIALS + 1) / 2 - 1] / 1024 / 1024);
+    }
+
+    delete[] buffer;
+}
+
+// Lengths of the perf mode, and the bytes each kernel checksums per length.
+static const size_t PERF_LENGTHS[] = { 64, 1024, 16384, 262144 };
+static const size_t PERF_BYTES = 256 * 1024 * 1024;
+
+static const uint64_t PERF_L1D_READ_MISS = PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+static const uint64_t PERF_LL_READ_MISS = PERF_COUNT_HW_CACHE_LL |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+/* The counters of the perf mode, each reported per byte or per call. task-clock is a software
+   event, so it also counts where the hardware events are not available. */
+static const struct {
+    uint32_t type;
+    uint64_t config;
+    const char* name;
+    bool perByte;
+} PERF_EVENTS[] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, "cycles/B", true },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instr/B", true },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, "brmiss/call", false },
+    { PERF_TYPE_HW_CACHE, PERF_L1D_READ_MISS, "L1dmiss/call", false },
+    { PERF_TYPE_HW_CACHE, PERF_LL_READ_MISS, "LLCmiss/call", false },
+    { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, "ns/B", true },
+};
+static const size_t NUM_PERF_EVENTS = sizeof(PERF_EVENTS)/sizeof(*PERF_EVENTS);
+
+// A counter of this thread in user space, disabled until enabled with an ioctl; -1 if the
+// kernel, its perf_event_paranoid setting or the virtual machine does not allow it.
+static int perfOpen(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the counters run one at a time when there are more events than hardware counters
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// The count of an event, scaled up for the time it was not running; -1 if it never ran.
+static double perfRead(int fd) {
+    uint64_t values[3];
+    if (read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+        return -1;
+    }
+    return (double) values[0] * values[1] / values[2];
+}
+
+/* Cycles and instructions per byte, branch, L1 data and last level cache misses per call of
+   each kernel and length, from perf_event_open. Events that cannot be opened are left out,
+   with a note; timing is then still done with the task-clock event. */
+static void runPerf() {
+    int fds[NUM_PERF_EVENTS];
+    size_t opened = 0;
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+        fds[e] = perfOpen(PERF_EVENTS[e].type, PERF_EVENTS[e].config);
+        if (fds[e] < 0) {
+            fprintf(stderr, "%s: %s\n", PERF_EVENTS[e].name, strerror(errno));
+        } else {
+            ++opened;
+        }
+    }
+    if (opened < NUM_PERF_EVENTS) {
+        fprintf(stderr, "some perf events are not available: check /proc/sys/kernel/perf_event_paranoid, "
+                "or the virtual machine may not expose a PMU\n");
+    }
+    if (opened == 0) {
+        return;
+    }
+
+    size_t maxLength = PERF_LENGTHS[sizeof(PERF_LENGTHS)/sizeof(*PERF_LENGTHS) - 1];
+    char* buffer = new char[maxLength];
+    for (size_t i = 0; i < maxLength; ++i) {
+        buffer[i] = (char) i;
+    }
+
+    printf("function\t\tbytes");
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+        if (fds[e] >= 0) {
+            printf("\t%s", PERF_EVENTS[e].name);
+        }
+    }
+    printf("\n");
+
+    for (size_t fnIndex = 0; fnIndex < NUM_VALID_FUNCTIONS; ++fnIndex) {
+        for (size_t lengthIndex = 0; lengthIndex < sizeof(PERF_LENGTHS)/sizeof(*PERF_LENGTHS);
+                ++lengthIndex) {
+            size_t length = PERF_LENGTHS[lengthIndex];
+            size_t calls = PERF_BYTES / length;
+            // warm the caches and the branch predictors
+            uint32_t crc = FNINFO[fnIndex].crcfn(crc32cInit(), buffer, length);
+
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                if (fds[e] >= 0) {
+                    ioctl(fds[e], PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+            for (size_t i = 0; i < calls; ++i) {
+                crc = FNINFO[fnIndex].crcfn(crc, buffer, length);
+            }
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                if (fds[e] >= 0) {
+                    ioctl(fds[e], PERF_EVENT_IOC_DISABLE, 0);
+                }
+            }
+            if (crc == 0x12345678) printf(" ");     // keep the calls
+
+            printf("%-16s\t%zu", FNINFO[fnIndex].name, length);
+            for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+                if (fds[e] < 0) {
+                    continue;
+                }
+                double count = perfRead(fds[e]);
+                if (count < 0) {
+                    printf("\t-");
+                } else {
+                    printf("\t%.3f", count / (PERF_EVENTS[e].perByte ? (double) calls * length : calls));
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    for (size_t e = 0; e < NUM_PERF_EVENTS; ++e) {
+        if (fds[e] >= 0) {
+            close(fds[e]);
+        }
+    }
+    delete[] buffer;
+}
+
+// Message sizes of the latency mode, the calls timed per kernel and size, and the percentiles
+// reported.
+static const size_t LATENCY_LENGTHS[] = { 16, 64, 128, 256, 512 };
+static const size_t LATENCY_SAMPLES = 100000;
+static const double LATENCY_PERCENTILES[] = { 50, 90, 99, 99.9 };
+
+// Ticks of the time stamp counter per nanosecond, from a CLOCK_MONOTONIC interval.
+static double tscPerNanosecond() {
+    int64_t startTime = nanoseconds();
+    uint64_t startTsc = CycleTimer::rdtsc();
+    while (nanoseconds() - startTime < 50 * 1000 * 1000) {
+    }
+    return (double) (CycleTimer::rdtsc() - startTsc) / (nanoseconds() - startTime);
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    size_t i = (size_t) (p / 100 * sorted.size());
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+/* p50 to p99.9 of single calls at small sizes, in ns, timed with CycleTimer. The median time
+   of an empty CycleTimer interval is subtracted from each call. */
+static void runLatency() {
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) || !(edx & (1 << 27))) {
+        fprintf(stderr, "latency needs the rdtscp instruction\n");
+        return;
+    }
+
+    double tscPerNs = tscPerNanosecond();
+    std::vector<uint64_t> samples(LATENCY_SAMPLES);
+    CycleTimer timer;
+    for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+        timer.start();
+        timer.end();
+        samples[i] = timer.getCycles();
+    }
+    std::sort(samples.begin(), samples.end());
+    uint64_t overhead = percentile(samples, 50);
+    printf("# %.3f tsc ticks/ns, timer overhead %llu ticks subtracted\n", tscPerNs,
+            (unsigned long long) overhead);
+
+    char buffer[512];
+    for (size_t i = 0; i < sizeof(buffer); ++i) {
+        buffer[i] = (char) i;
+    }
+
+    printf("function\t\tbytes");
+    for (double p : LATENCY_PERCENTILES) {
+        printf("\tp%g ns", p);
+    }
+    printf("\n");
+    for (size_t fnIndex = 0; fnIndex < NUM_VALID_FUNCTIONS; ++fnIndex) {
+        for (size_t length : LATENCY_LENGTHS) {
+            uint32_t crc = FNINFO[fnIndex].crcfn(crc32cInit(), buffer, length);
+            for (size_t i = 0; i < LATENCY_SAMPLES; ++i) {
+                timer.start();
+                crc = FNINFO[fnIndex].crcfn(crc, buffer, length);
+                timer.end();
+                uint64_t cycles = timer.getCycles();
+                samples[i] = cycles > overhead ? cycles - overhead : 0;
+            }
+            if (crc == 0x12345678) printf(" ");     // keep the calls
+            std::sort(samples.begin(), samples.end());
+
+            printf("%-16s\t%zu", FNINFO[fnIndex].name, length);
+            for (double p : LATENCY_PERCENTILES) {
+                printf("\t%.1f", percentile(samples, p) / tscPerNs);
+            }
+            printf("\n");
+        }
+    }
+}
+
+// Number of times the startup mode starts this program.
+static const int STARTUPS = 1000;
+
+extern char** environ;
+
+static void runNone() {
+}
+
+// What detectBestCRC32C picks on this machine and why, as a program would log it at startup.
+static void runDispatch() {
+    CRC32CDispatch dispatch = crc32cDispatch();
+    printf("vendor\tfamily\tmodel\tsse4.2\tpclmul\tmicroarchitecture\tkernel\n");
+    printf("%s\t0x%x\t0x%x\t%d\t%d\t%s\t%s%s\n", dispatch.vendor, dispatch.family, dispatch.model,
+            dispatch.sse42, dispatch.pclmul,
+            dispatch.microarchitecture != NULL ? dispatch.microarchitecture : "unknown", dispatch.kernel,
+            dispatch.forced ? " (CRC32C_KERNEL)" : "");
+}
+
+/* Average time to start and stop this program, which links the whole library. Anything the
+   library does before main, like filling tables in a constructor, shows up here. */
+static void runStartup() {
+    char path[4096];
+    ssize_t pathLength = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (pathLength < 0) {
+        perror("readlink /proc/self/exe");
+        return;
+    }
+    path[pathLength] = '\0';
+    char* argv[] = { path, (char*) "none", NULL };
+
+    int64_t startTime = nanoseconds();
+    for (int i = 0; i < STARTUPS; ++i) {
+        pid_t pid;
+        int status;
+        if (posix_spawn(&pid, path, NULL, NULL, argv, environ) != 0) {
+            perror("posix_spawn");
+            return;
+        }
+        waitpid(pid, &status, 0);
+    }
+    double duration = (double) (nanoseconds() - startTime);
+
+    printf("startups\tus/startup\n");
+    printf("%d\t%.1f\n", STARTUPS, duration / 1000.0 / STARTUPS);
+}
+
+struct BenchModeInfo {
+    void (*run)();
+    const char* name;
+    const char* help;
+};
+
+static const BenchModeInfo MODES[] = {
+    { runThroughput, "throughput", "MiB/sec of each function for a range of lengths (default)" },
+    { runCsv, "csv", "the throughput mode as CSV, with the machine and the build, for compare" },
+    { runJson, "json", "the throughput mode as JSON, with the machine and the build" },
+    { runCompare, "compare", "rerun a csv baseline and report throughput regressions: compare file [threshold%]" },
+    { runCombines, "combine", "latency of the pclmulqdq combine step per block, by lane count" },
+    { runCache, "cache", "ns per call with hot caches and after flushing the caches" },
+    { runPressure, "pressure", "ns per call of the table kernels next to a working set of growing size" },
+    { runSize, "size", "bytes of code of each function" },
+    { runICache, "icache", "ns per call with hot caches and after flushing the instruction cache" },
+    { runFixed, "fixed", "crc32cFixed<N> against the runtime length functions at N bytes" },
+    { runSectors, "sectors", "crc32cSectors against crc32cIntelC per sector" },
+    { runPerf, "perf", "cycles and instructions per byte, branch and cache misses per call, from perf events" },
+    { runDram, "dram", "MiB/sec on a 1 GiB buffer for a range of prefetch distances" },
+    { runPadded, "padded", "crc32cPadded against the other kernels on random lengths" },
+    { runRandom, "random", "ns per call on uniform and log-normal random lengths against a fixed length" },
+    { runLatency, "latency", "p50, p90, p99 and p99.9 ns of single calls at 16 to 512 bytes" },
+    { runStats, "stats", "ns per call of crc32c with the usage counters off and on, and the counters" },
+    { runDispatch, "dispatch", "the kernel crc32c uses on this machine, and the cpuid data it was picked by" },
+    { runStartup, "startup", "time to start a program that links the library" },
+    { runNone, "none", "do nothing, used by the startup mode" },
+};
+
+int main(int argc, char* argv[]) {
+    const char* mode = argc > 1 ? argv[1] : MODES[0].name;
+    modeArguments = argv + (argc > 1 ? 2 : 1);
+    for (size_t i = 0; i < sizeof(MODES)/sizeof(*MODES); ++i) {
+        if (strcmp(mode, MODES[i].name) == 0) {
+            MODES[i].run();
+            return modeStatus;
+        }
+    }
+
+    fprintf(stderr, "usage: %s [mode]\n", argv[0]);
+    for (size_t i = 0; i < sizeof(MODES)/sizeof(*MODES); ++i) {
+        fprintf(stderr, "  %-12s %s\n", MODES[i].name, MODES[i].help);
+    }
+    return 1;
+}
@@ -0,0 +1,223 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/* Usage counters of the kernels behind crc32c. While counting is on, crc32c points at
+crc32cCounted, which adds the call to counters of the calling thread and then calls the kernel.
+Each thread has its own counters, so the calls do not share cache lines; they are only written
+by their thread and read with relaxed atomics by crc32cStatsSnapshot. When a thread exits its
+counters are added to those of the exited threads, and so are calls it makes after that, from
+the destructors of other thread_local objects. */
+
+#include "logging/crc32c.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace logging {
+
+struct CRC32CCounters {
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> buckets[CRC32C_STATS_BUCKETS];
+};
+
+/* Only the owning thread writes, so a load and a store do; no locked instruction needed. */
+static inline void crc32cCount(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+static inline size_t crc32cBucket(size_t length) {
+    size_t bucket = length == 0 ? 0 : 64 - __builtin_clzll(length);
+    return bucket < CRC32C_STATS_BUCKETS ? bucket : CRC32C_STATS_BUCKETS - 1;
+}
+
+struct CRC32CThreadStats;
+
+static std::mutex statsMutex;
+// the counters of the running threads, and the sums of those that have exited
+static std::set<CRC32CThreadStats*> statsThreads;
+static std::unique_ptr<CRC32CCounters[]> statsExited;
+
+static bool crc32cStatsFromEnvironment() {
+    const char* value = getenv("CRC32C_STATS");
+    return value != NULL && strcmp(value, "1") == 0;
+}
+
+static bool statsEnabled = crc32cStatsFromEnvironment();
+
+static size_t crc32cKernelCount() {
+    size_t count;
+    crc32cKernels(&count);
+    return count;
+}
+
+// A kernel and its index in crc32cKernels and in the counters.
+struct CRC32CStatsTarget {
+    const CRC32CKernel* kernel;
+    size_t index;
+};
+
+// One target per kernel, filled once under statsMutex, and the one crc32cCounted calls. Both are
+// constant initialized, so kernels can be installed from static constructors. crc32cEnableStats
+// may change the target while other threads call crc32c, so it is published as one pointer.
+static std::unique_ptr<CRC32CStatsTarget[]> statsTargets;
+static std::atomic<const CRC32CStatsTarget*> statsTarget;
+
+static void crc32cAddCounters(CRC32CCounters* sum, const CRC32CCounters* counters, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        crc32cCount(sum[i].calls, counters[i].calls.load(std::memory_order_relaxed));
+        crc32cCount(sum[i].bytes, counters[i].bytes.load(std::memory_order_relaxed));
+        for (size_t b = 0; b < CRC32C_STATS_BUCKETS; ++b) {
+            crc32cCount(sum[i].buckets[b], counters[i].buckets[b].load(std::memory_order_relaxed));
+        }
+    }
+}
+
+struct CRC32CThreadStats {
+    size_t count;
+    std::unique_ptr<CRC32CCounters[]> counters;
+
+    CRC32CThreadStats() : count(crc32cKernelCount()), counters(new CRC32CCounters[count]()) {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        statsThreads.insert(this);
+    }
+
+    ~CRC32CThreadStats();
+};
+
+// The counters of this thread. A plain pointer, so using it needs no check that the
+// CRC32CThreadStats of the thread is constructed. NULL again once it is destroyed.
+static thread_local CRC32CCounters* threadCounters;
+static thread_local bool threadExited;
+
+CRC32CThreadStats::~CRC32CThreadStats() {
+    threadCounters = NULL;
+    threadExited = true;
+    std::lock_guard<std::mutex> lock(statsMutex);
+    statsThreads.erase(this);
+    if (!statsExited) {
+        statsExited.reset(new CRC32CCounters[count]());
+    }
+    crc32cAddCounters(statsExited.get(), counters.get(), count);
+}
+
+static void crc32cCountCall(CRC32CCounters& counters, size_t length) {
+    crc32cCount(counters.calls, 1);
+    crc32cCount(counters.bytes, length);
+    crc32cCount(counters.buckets[crc32cBucket(length)], 1);
+}
+
+// A call after the counters of this thread were destroyed goes straight to the exited threads.
+static void crc32cCountExited(size_t index, size_t length) {
+    std::lock_guard<std::mutex> lock(statsMutex);
+    if (!statsExited) {
+        statsExited.reset(new CRC32CCounters[crc32cKernelCount()]());
+    }
+    crc32cCountCall(statsExited[index], length);
+}
+
+static CRC32CCounters* crc32cThreadCounters() {
+    if (threadExited) {
+        return NULL;
+    }
+    static thread_local CRC32CThreadStats stats;
+    threadCounters = stats.counters.get();
+    return threadCounters;
+}
+
+static uint32_t crc32cCounted(uint32_t crc, const void* data, size_t length) {
+    const CRC32CStatsTarget* target = statsTarget.load(std::memory_order_acquire);
+    CRC32CCounters* threadKernels = threadCounters;
+    if (threadKernels == NULL) {
+        threadKernels = crc32cThreadCounters();
+    }
+    if (threadKernels != NULL) {
+        crc32cCountCall(threadKernels[target->index], length);
+    } else {
+        crc32cCountExited(target->index, length);
+    }
+    return target->kernel->function(crc, data, length);
+}
+
+CRC32CFunctionPtr crc32cStatsFunction(const CRC32CKernel& kernel) {
+    if (!statsEnabled) {
+        return kernel.function;
+    }
+    size_t count;
+    const CRC32CKernel* kernels = crc32cKernels(&count);
+    const CRC32CStatsTarget* targets;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (!statsTargets) {
+            statsTargets.reset(new CRC32CStatsTarget[count]);
+            for (size_t i = 0; i < count; ++i) {
+                statsTargets[i] = { &kernels[i], i };
+            }
+        }
+        targets = statsTargets.get();
+    }
+    statsTarget.store(&targets[&kernel - kernels], std::memory_order_release);
+    return crc32cCounted;
+}
+
+bool crc32cStatsEnabled() {
+    return statsEnabled;
+}
+
+void crc32cEnableStats(bool enable) {
+    // the kernel crc32c uses now; none while it still has to detect one, which will look at
+    // statsEnabled itself
+    const CRC32CKernel* current = NULL;
+    if (crc32c == crc32cCounted) {
+        current = statsTarget.load(std::memory_order_acquire)->kernel;
+    } else {
+        size_t count;
+        const CRC32CKernel* kernels = crc32cKernels(&count);
+        for (size_t i = 0; i < count; ++i) {
+            if (kernels[i].function == crc32c) {
+                current = &kernels[i];
+            }
+        }
+    }
+
+    statsEnabled = enable;
+    if (current != NULL) {
+        crc32c = crc32cStatsFunction(*current);
+    }
+}
+
+size_t crc32cStatsSnapshot(CRC32CKernelStats* out, size_t max) {
+    size_t count;
+    const CRC32CKernel* kernels = crc32cKernels(&count);
+    std::unique_ptr<CRC32CCounters[]> sum(new CRC32CCounters[count]());
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        if (statsExited) {
+            crc32cAddCounters(sum.get(), statsExited.get(), count);
+        }
+        for (CRC32CThreadStats* thread : statsThreads) {
+            crc32cAddCounters(sum.get(), thread->counters.get(), count);
+        }
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < count && n < max; ++i) {
+        if (sum[i].calls.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        out[n].name = kernels[i].name;
+        out[n].calls = sum[i].calls.load(std::memory_order_relaxed);
+        out[n].bytes = sum[i].bytes.load(std::memory_order_relaxed);
+        for (size_t b = 0; b < CRC32C_STATS_BUCKETS; ++b) {
+            out[n].buckets[b] = sum[i].buckets[b].load(std::memory_order_relaxed);
+        }
+        ++n;
+    }
+    return n;
+}
+
+}  // namespace logging
@@ -38,6 +38,16 @@
 
 /* Version history:
   1.0  07 May 2016  Ferry Toth - First version
+  1.1  19 Oct 2026  Duff's device replaced by a template on the lane count and block size,
+                    K constants generated at compile time
+  1.2  19 Oct 2026  Added crc32cIntelCAdaptive, block size picked from the input length
+  1.3  19 Oct 2026  Added crc32cFixed<N>
+  1.4  19 Oct 2026  Added crc32cSectors
+  1.5  19 Oct 2026  Added crc32cPadded
+  1.6  19 Oct 2026  Added crc32cIntelCLoop
+  1.7  19 Oct 2026  Added crc32cIntelCCompact
+  1.8  19 Oct 2026  Added crc32cIntelCStream and crc32cIntelCPrefetch
+  1.9  19 Oct 2026  crc32cIntelCAdaptive computes its combine constants per block size
 */
 
 #include "logging/crc32c.h"
@@ -47,327 +57,32 @@
 namespace logging
 {
 
-extern __v2di K[];
-
-/* Compute CRC-32C using the Intel hardware instruction. */
-uint32_t crc32cIntelC ( uint32_t crc, const void *buf, size_t len )
+/* Bring next to an eight-byte boundary, computing the crc for up to seven leading bytes. */
+static inline CRC_NATIVE crc32cAlign ( CRC_NATIVE crc0, const unsigned char *&next, size_t &len )
 {
-        const unsigned char *next = ( const unsigned char * ) buf;
-        unsigned long count;
-        CRC_NATIVE crc0, crc1, crc2;
-        crc0 = crc;
+        uint32_t crc32bit = crc0;
+        unsigned long align = ( 8 - ( uintptr_t ) next ) % 8;           // byte to boundary
+        len -= align;
+        if ( align & 0x04 ) {
+                crc32bit = __builtin_ia32_crc32si ( crc32bit, * ( uint32_t* ) next );
+                next += sizeof(uint32_t);
+        };
+        if ( align & 0x02 ) {
+                crc32bit = __builtin_ia32_crc32hi ( crc32bit, * ( uint16_t* ) next );
+                next += sizeof(uint16_t);
+        };
+
+        if ( align & 0x01 ) {
+                crc32bit = __builtin_ia32_crc32qi ( crc32bit, * ( next ) );
+                next++;
+        };
+        return crc32bit;
+}
 
+/* Compute the crc of the last 216 or less bytes, 27 or less singlets and up to seven trailing bytes. */
+static inline uint32_t crc32cTail ( CRC_NATIVE crc0, const unsigned char *next, size_t len )
+{
         if ( len >= 8 ) {
-                // if len > 216 then align and use triplets
-                if ( len > 216 ) {
-                        {
-                                uint32_t crc32bit = crc0;                                       // create this block actually prevent 2 asignments
-                                unsigned long align = ( 8 - ( uintptr_t ) next ) % 8;           // byte to boundary
-                                len -= align;
-                                if ( align & 0x04 ) {
-                                        crc32bit = __builtin_ia32_crc32si ( crc32bit, * ( uint32_t* ) next );
-                                        next += sizeof(uint32_t);
-                                };
-                                if ( align & 0x02 ) {
-                                        crc32bit = __builtin_ia32_crc32hi ( crc32bit, * ( uint16_t* ) next );
-                                        next += sizeof(uint16_t);
-                                };
-
-                                if ( align & 0x01 ) {
-                                        crc32bit = __builtin_ia32_crc32qi ( crc32bit, * ( next ) );
-                                        next++;
-                                };
-                                crc0 = crc32bit;
-                        };
-
-                        // use Duff's device, a for() loop inside a switch() statement. This is Legal
-                        // needs to execute at least once, round len down to nearast triplet multiple
-                        count = len / 24;			// number of triplets
-                        len %= 24;				// bytes remaining
-                        unsigned long n = count / 128;		// #blocks = first block + full blocks
-                        unsigned long block_size = count % 128;
-                        if ( block_size == 0 ) {
-                                block_size = 128;
-                        } else {
-                                n++;
-                        };
-                        const uint64_t *next0 = ( uint64_t* ) next + block_size; // points to the first byte of the next block
-                        const uint64_t *next1 = next0 + block_size;
-                        const uint64_t *next2 = next1 + block_size;
-
-                        crc1 = crc2 = 0;
-                        switch ( block_size ) {
-                        case 128:
-                                do {
-                                        CRCtriplet ( crc, next, -128 );	// jumps here for a full block of len 128
-                                case 127:
-                                        CRCtriplet ( crc, next, -127 );	// jumps here or below for the first block smaller
-                                case 126:
-                                        CRCtriplet ( crc, next, -126 );	// than 128
-                                case 125:
-                                        CRCtriplet ( crc, next, -125 );
-                                case 124:
-                                        CRCtriplet ( crc, next, -124 );
-                                case 123:
-                                        CRCtriplet ( crc, next, -123 );
-                                case 122:
-                                        CRCtriplet ( crc, next, -122 );
-                                case 121:
-                                        CRCtriplet ( crc, next, -121 );
-                                case 120:
-                                        CRCtriplet ( crc, next, -120 );
-                                case 119:
-                                        CRCtriplet ( crc, next, -119 );
-                                case 118:
-                                        CRCtriplet ( crc, next, -118 );
-                                case 117:
-                                        CRCtriplet ( crc, next, -117 );
-                                case 116:
-                                        CRCtriplet ( crc, next, -116 );
-                                case 115:
-                                        CRCtriplet ( crc, next, -115 );
-                                case 114:
-                                        CRCtriplet ( crc, next, -114 );
-                                case 113:
-                                        CRCtriplet ( crc, next, -113 );
-                                case 112:
-                                        CRCtriplet ( crc, next, -112 );
-                                case 111:
-                                        CRCtriplet ( crc, next, -111 );
-                                case 110:
-                                        CRCtriplet ( crc, next, -110 );
-                                case 109:
-                                        CRCtriplet ( crc, next, -109 );
-                                case 108:
-                                        CRCtriplet ( crc, next, -108 );
-                                case 107:
-                                        CRCtriplet ( crc, next, -107 );
-                                case 106:
-                                        CRCtriplet ( crc, next, -106 );
-                                case 105:
-                                        CRCtriplet ( crc, next, -105 );
-                                case 104:
-                                        CRCtriplet ( crc, next, -104 );
-                                case 103:
-                                        CRCtriplet ( crc, next, -103 );
-                                case 102:
-                                        CRCtriplet ( crc, next, -102 );
-                                case 101:
-                                        CRCtriplet ( crc, next, -101 );
-                                case 100:
-                                        CRCtriplet ( crc, next, -100 );
-                                case 99:
-                                        CRCtriplet ( crc, next, -99 );
-                                case 98:
-                                        CRCtriplet ( crc, next, -98 );
-                                case 97:
-                                        CRCtriplet ( crc, next, -97 );
-                                case 96:
-                                        CRCtriplet ( crc, next, -96 );
-                                case 95:
-                                        CRCtriplet ( crc, next, -95 );
-                                case 94:
-                                        CRCtriplet ( crc, next, -94 );
-                                case 93:
-                                        CRCtriplet ( crc, next, -93 );
-                                case 92:
-                                        CRCtriplet ( crc, next, -92 );
-                                case 91:
-                                        CRCtriplet ( crc, next, -91 );
-                                case 90:
-                                        CRCtriplet ( crc, next, -90 );
-                                case 89:
-                                        CRCtriplet ( crc, next, -89 );
-                                case 88:
-                                        CRCtriplet ( crc, next, -88 );
-                                case 87:
-                                        CRCtriplet ( crc, next, -87 );
-                                case 86:
-                                        CRCtriplet ( crc, next, -86 );
-                                case 85:
-                                        CRCtriplet ( crc, next, -85 );
-                                case 84:
-                                        CRCtriplet ( crc, next, -84 );
-                                case 83:
-                                        CRCtriplet ( crc, next, -83 );
-                                case 82:
-                                        CRCtriplet ( crc, next, -82 );
-                                case 81:
-                                        CRCtriplet ( crc, next, -81 );
-                                case 80:
-                                        CRCtriplet ( crc, next, -80 );
-                                case 79:
-                                        CRCtriplet ( crc, next, -79 );
-                                case 78:
-                                        CRCtriplet ( crc, next, -78 );
-                                case 77:
-                                        CRCtriplet ( crc, next, -77 );
-                                case 76:
-                                        CRCtriplet ( crc, next, -76 );
-                                case 75:
-                                        CRCtriplet ( crc, next, -75 );
-                                case 74:
-                                        CRCtriplet ( crc, next, -74 );
-                                case 73:
-                                        CRCtriplet ( crc, next, -73 );
-                                case 72:
-                                        CRCtriplet ( crc, next, -72 );
-                                case 71:
-                                        CRCtriplet ( crc, next, -71 );
-                                case 70:
-                                        CRCtriplet ( crc, next, -70 );
-                                case 69:
-                                        CRCtriplet ( crc, next, -69 );
-                                case 68:
-                                        CRCtriplet ( crc, next, -68 );
-                                case 67:
-                                        CRCtriplet ( crc, next, -67 );
-                                case 66:
-                                        CRCtriplet ( crc, next, -66 );
-                                case 65:
-                                        CRCtriplet ( crc, next, -65 );
-                                case 64:
-                                        CRCtriplet ( crc, next, -64 );
-                                case 63:
-                                        CRCtriplet ( crc, next, -63 );
-                                case 62:
-                                        CRCtriplet ( crc, next, -62 );
-                                case 61:
-                                        CRCtriplet ( crc, next, -61 );
-                                case 60:
-                                        CRCtriplet ( crc, next, -60 );
-                                case 59:
-                                        CRCtriplet ( crc, next, -59 );
-                                case 58:
-                                        CRCtriplet ( crc, next, -58 );
-                                case 57:
-                                        CRCtriplet ( crc, next, -57 );
-                                case 56:
-                                        CRCtriplet ( crc, next, -56 );
-                                case 55:
-                                        CRCtriplet ( crc, next, -55 );
-                                case 54:
-                                        CRCtriplet ( crc, next, -54 );
-                                case 53:
-                                        CRCtriplet ( crc, next, -53 );
-                                case 52:
-                                        CRCtriplet ( crc, next, -52 );
-                                case 51:
-                                        CRCtriplet ( crc, next, -51 );
-                                case 50:
-                                        CRCtriplet ( crc, next, -50 );
-                                case 49:
-                                        CRCtriplet ( crc, next, -49 );
-                                case 48:
-                                        CRCtriplet ( crc, next, -48 );
-                                case 47:
-                                        CRCtriplet ( crc, next, -47 );
-                                case 46:
-                                        CRCtriplet ( crc, next, -46 );
-                                case 45:
-                                        CRCtriplet ( crc, next, -45 );
-                                case 44:
-                                        CRCtriplet ( crc, next, -44 );
-                                case 43:
-                                        CRCtriplet ( crc, next, -43 );
-                                case 42:
-                                        CRCtriplet ( crc, next, -42 );
-                                case 41:
-                                        CRCtriplet ( crc, next, -41 );
-                                case 40:
-                                        CRCtriplet ( crc, next, -40 );
-                                case 39:
-                                        CRCtriplet ( crc, next, -39 );
-                                case 38:
-                                        CRCtriplet ( crc, next, -38 );
-                                case 37:
-                                        CRCtriplet ( crc, next, -37 );
-                                case 36:
-                                        CRCtriplet ( crc, next, -36 );
-                                case 35:
-                                        CRCtriplet ( crc, next, -35 );
-                                case 34:
-                                        CRCtriplet ( crc, next, -34 );
-                                case 33:
-                                        CRCtriplet ( crc, next, -33 );
-                                case 32:
-                                        CRCtriplet ( crc, next, -32 );
-                                case 31:
-                                        CRCtriplet ( crc, next, -31 );
-                                case 30:
-                                        CRCtriplet ( crc, next, -30 );
-                                case 29:
-                                        CRCtriplet ( crc, next, -29 );
-                                case 28:
-                                        CRCtriplet ( crc, next, -28 );
-                                case 27:
-                                        CRCtriplet ( crc, next, -27 );
-                                case 26:
-                                        CRCtriplet ( crc, next, -26 );
-                                case 25:
-                                        CRCtriplet ( crc, next, -25 );
-                                case 24:
-                                        CRCtriplet ( crc, next, -24 );
-                                case 23:
-                                        CRCtriplet ( crc, next, -23 );
-                                case 22:
-                                        CRCtriplet ( crc, next, -22 );
-                                case 21:
-                                        CRCtriplet ( crc, next, -21 );
-                                case 20:
-                                        CRCtriplet ( crc, next, -20 );
-                                case 19:
-                                        CRCtriplet ( crc, next, -19 );
-                                case 18:
-                                        CRCtriplet ( crc, next, -18 );
-                                case 17:
-                                        CRCtriplet ( crc, next, -17 );
-                                case 16:
-                                        CRCtriplet ( crc, next, -16 );
-                                case 15:
-                                        CRCtriplet ( crc, next, -15 );
-                                case 14:
-                                        CRCtriplet ( crc, next, -14 );
-                                case 13:
-                                        CRCtriplet ( crc, next, -13 );
-                                case 12:
-                                        CRCtriplet ( crc, next, -12 );
-                                case 11:
-                                        CRCtriplet ( crc, next, -11 );
-                                case 10:
-                                        CRCtriplet ( crc, next, -10 );
-                                case 9:
-                                        CRCtriplet ( crc, next, -9 );
-                                case 8:
-                                        CRCtriplet ( crc, next, -8 );
-                                case 7:
-                                        CRCtriplet ( crc, next, -7 );
-                                case 6:
-                                        CRCtriplet ( crc, next, -6 );
-                                case 5:
-                                        CRCtriplet ( crc, next, -5 );
-                                case 4:
-                                        CRCtriplet ( crc, next, -4 );
-                                case 3:
-                                        CRCtriplet ( crc, next, -3 );
-                                case 2:
-                                        CRCtriplet ( crc, next, -2 );
-                                case 1:
-                                        CRCduplet ( crc, next, -1 );		        // the final triplet is actually only 2
-                                        CombineCRC();
-                                        if ( --n > 0 ) {
-                                                crc1 = crc2 = 0;
-                                                block_size = 128;
-                                                next0 = next2 + 128;			// points to the first byte of the next block
-                                                next1 = next0 + 128;			// from here on all blocks are 128 long
-                                                next2 = next1 + 128;
-                                        };
-                                case 0:
-                                        ;
-                                } while ( n > 0 );
-                        };
-                        next = ( const unsigned char* ) next2;
-                };
                 unsigned count = len / 8;                                               // 216 of less bytes is 27 or less singlets
                 len %= 8;
                 next += ( count * 8 );
@@ -431,25 +146,419 @@ uint32_t crc32cIntelC ( uint32_t crc, const void *buf, size_t len )
                 };
 
         };
-        {
-                uint32_t crc32bit = crc0;
-                // less than 8 bytes remain
-                /* compute the crc for up to seven trailing bytes */
-                if ( len & 0x04 ) {
-                        crc32bit = __builtin_ia32_crc32si ( crc32bit, * ( uint32_t* ) next );
-                        next += 4;
+        uint32_t crc32bit = crc0;
+        // less than 8 bytes remain
+        /* compute the crc for up to seven trailing bytes */
+        if ( len & 0x04 ) {
+                crc32bit = __builtin_ia32_crc32si ( crc32bit, * ( uint32_t* ) next );
+                next += 4;
+        };
+        if ( len & 0x02 ) {
+                crc32bit = __builtin_ia32_crc32hi ( crc32bit, * ( uint16_t* ) next );
+                next += 2;
+        };
+
+        if ( len & 0x01 ) {
+                crc32bit = __builtin_ia32_crc32qi ( crc32bit, * ( next ) );
+        };
+        return ( uint32_t ) crc32bit;
+}
+
+/*
+ * Compute CRC-32C using the Intel hardware instruction, on Lanes lanes in parallel. Data is
+ * processed in blocks of up to BlockSize words per lane, the first block takes what does not
+ * fit in full blocks. Which lane count is fastest depends on the crc32 latency / throughput
+ * ratio of the microarchitecture; Intel's original code uses 3 lanes and blocks of 128.
+ */
+template <unsigned Lanes, size_t BlockSize>
+static uint32_t crc32cIntelCLanes ( uint32_t crc, const void *buf, size_t len )
+{
+        static constexpr CRC32CShiftTable< ( Lanes - 1 ) * BlockSize> K {};
+        const unsigned char *next = ( const unsigned char * ) buf;
+        CRC_NATIVE crc0 = crc;
+
+        // if len > 216 then align and use the lanes
+        if ( len > 216 ) {
+                crc0 = crc32cAlign ( crc0, next, len );
+
+                size_t count = len / ( 8 * Lanes );             // number of words per lane
+                len %= 8 * Lanes;                               // bytes remaining
+                const uint64_t *next64 = ( const uint64_t* ) next;
+
+                // the first block takes the remainder, so all following blocks are full
+                // and run with a constant block size
+                size_t block_size = count % BlockSize;
+                if ( block_size != 0 ) {
+                        crc0 = CRCblock<Lanes> ( crc0, next64, block_size, K.k );
+                        next64 += Lanes * block_size;
+                        count -= block_size;
                 };
-                if ( len & 0x02 ) {
-                        crc32bit = __builtin_ia32_crc32hi ( crc32bit, * ( uint16_t* ) next );
-                        next += 2;
+                while ( count > 0 ) {
+                        crc0 = CRCblock<Lanes> ( crc0, next64, BlockSize, K.k );
+                        next64 += Lanes * BlockSize;
+                        count -= BlockSize;
                 };
+                next = ( const unsigned char* ) next64;
+        };
+        return crc32cTail ( crc0, next, len );
+}
+
+/*
+ * The combine constants of crc32cIntelCAdaptiveLanes for one block size, indexed like a
+ * CRC32CShiftTable: K(block) from the split tables, K(j * block) from j - 1 more multiplies.
+ * They do not depend on the data, so they are computed while the crc32 chains run.
+ */
+template <unsigned Lanes>
+struct CRC32CAdaptiveShift {
+        size_t block;
+        uint32_t k[Lanes];
+
+        template <size_t N>
+        void reset ( size_t block_size, const CRC32CSplitShift<N> &split )
+        {
+                block = block_size;
+                k[1] = ( uint32_t ) CRCmultiply ( split.high[block / 64], split.low[block % 64] );
+                for ( unsigned j = 2; j < Lanes; j++ ) {
+                        k[j] = ( uint32_t ) CRCmultiply ( k[j - 1], k[1] );
+                }
+        }
 
-                if ( len & 0x01 ) {
-                        crc32bit = __builtin_ia32_crc32qi ( crc32bit, * ( next ) );
+        uint32_t operator[] ( size_t n ) const
+        {
+                return k[n / block];
+        }
+};
+
+/*
+ * Like crc32cIntelCLanes, but the block size is picked from the input length: the data is split
+ * in as few blocks of at most MaxBlock words per lane as possible, all of (nearly) the same size.
+ * Up to MaxBlock * Lanes * 8 bytes this is a single block with a single combine, where the fixed
+ * block size needs one combine per block and a partial first block. The block sizes take at most
+ * two values per call, so the combine constants are computed per block size instead of being
+ * looked up in a table of (Lanes - 1) * MaxBlock entries.
+ */
+template <unsigned Lanes, size_t MaxBlock>
+static uint32_t crc32cIntelCAdaptiveLanes ( uint32_t crc, const void *buf, size_t len )
+{
+        static constexpr CRC32CSplitShift<MaxBlock> SPLIT {};
+        const unsigned char *next = ( const unsigned char * ) buf;
+        CRC_NATIVE crc0 = crc;
+
+        if ( len > 216 ) {
+                crc0 = crc32cAlign ( crc0, next, len );
+
+                size_t count = len / ( 8 * Lanes );             // number of words per lane
+                len %= 8 * Lanes;                               // bytes remaining
+                const uint64_t *next64 = ( const uint64_t* ) next;
+
+                size_t blocks = ( count + MaxBlock - 1 ) / MaxBlock;
+                CRC32CAdaptiveShift<Lanes> K;
+                K.block = 0;
+                while ( count > 0 ) {
+                        size_t block_size = count / blocks--;
+                        if ( block_size != K.block ) {
+                                K.reset ( block_size, SPLIT );
+                        }
+                        crc0 = CRCblock<Lanes> ( crc0, next64, block_size, K );
+                        next64 += Lanes * block_size;
+                        count -= block_size;
                 };
-                return ( uint32_t ) crc32bit;
+                next = ( const unsigned char* ) next64;
         };
-};
+        return crc32cTail ( crc0, next, len );
+}
+
+/*
+ * Compute CRC-32C of exactly N bytes. N is a power of two, so the data is one block of N / 24
+ * words per lane plus 1 or 2 words, with all offsets and combine constants known at compile time.
+ * There are no length branches and no alignment step: unaligned 64 bit loads cost little on the
+ * processors that have crc32, and the data is usually aligned anyway.
+ */
+template <size_t N>
+uint32_t crc32cFixed ( uint32_t crc, const void *buf )
+{
+        static_assert ( N >= 256 && ( N & ( N - 1 ) ) == 0, "N must be a power of two of at least 256" );
+        static const size_t Words = N / 8;
+        static const size_t Block = Words / 3;
+        const uint64_t *next64 = ( const uint64_t* ) buf;
+
+        CRC_NATIVE crc0 = CRCfixedBlock<3, Block> ( crc, next64 );
+        for ( size_t i = 3 * Block; i < Words; i++ ) {
+                crc0 = CRCword ( crc0, next64 + i );
+        }
+        return ( uint32_t ) crc0;
+}
+
+template uint32_t crc32cFixed<256> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<512> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<1024> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<2048> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<4096> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<8192> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<16384> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<32768> ( uint32_t crc, const void *buf );
+template uint32_t crc32cFixed<65536> ( uint32_t crc, const void *buf );
+
+uint32_t crc32cIntelC ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<3, 128> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelCAdaptive ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCAdaptiveLanes<3, 4096> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelC2 ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<2, 128> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelC4 ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<4, 128> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelC5 ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<5, 128> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelC6 ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<6, 128> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelC7 ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<7, 128> ( crc, buf, len );
+}
+
+uint32_t crc32cIntelC8 ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cIntelCLanes<8, 128> ( crc, buf, len );
+}
+
+/*
+ * Compute the crc of the last len < 8 bytes with a single 8 byte load, which reads up to 8 bytes
+ * past the end of the data. The bytes past the end are masked to zero, which makes the crc32
+ * that of the data followed by 8 - len zero bytes; CRCmultiply divides those zeros out again.
+ */
+static inline uint32_t crc32cPaddedTail ( CRC_NATIVE crc0, const uint64_t *next64, size_t len )
+{
+        static constexpr CRC32CTailShift K {};
+        uint64_t word = *next64 & ~ ( ~0ULL << ( 8 * len ) );
+        crc0 = CRCword ( crc0, &word );
+        return ( uint32_t ) CRCmultiply ( crc0, K[len] );
+}
+
+/*
+ * Compute the crc of words 64 bit words with blocks of 128, 32 and 8 words per lane on 3 lanes,
+ * then single words. Every branch is a loop condition, so unlike the Duff's device entry of
+ * crc32cIntelCLanes random lengths cost no more mispredictions than the loop exits.
+ */
+static inline CRC_NATIVE crc32cWords ( CRC_NATIVE crc0, const uint64_t *&next64, size_t words )
+{
+        static constexpr CRC32CShiftTable<2 * 128> K {};
+
+        while ( words >= 3 * 128 ) {
+                crc0 = CRCblock<3> ( crc0, next64, 128, K.k );
+                next64 += 3 * 128;
+                words -= 3 * 128;
+        };
+        while ( words >= 3 * 32 ) {
+                crc0 = CRCblock<3> ( crc0, next64, 32, K.k );
+                next64 += 3 * 32;
+                words -= 3 * 32;
+        };
+        while ( words >= 3 * 8 ) {
+                crc0 = CRCblock<3> ( crc0, next64, 8, K.k );
+                next64 += 3 * 8;
+                words -= 3 * 8;
+        };
+        for ( ; words > 0; words-- ) {
+                crc0 = CRCword ( crc0, next64++ );
+        }
+        return crc0;
+}
+
+/*
+ * Compute CRC-32C of a buffer followed by at least CRC32C_PADDING readable bytes, see crc32c.h.
+ * Without the need to stay inside the buffer there is no alignment step, no jump table for the
+ * last 216 bytes and no bit tests for the last 7: crc32cWords, then one masked load.
+ */
+uint32_t crc32cPadded ( uint32_t crc, const void *buf, size_t len )
+{
+        const uint64_t *next64 = ( const uint64_t* ) buf;
+        CRC_NATIVE crc0 = crc32cWords ( crc, next64, len / 8 );
+        return crc32cPaddedTail ( crc0, next64, len % 8 );
+}
+
+/*
+ * crc32cIntelC without computed jumps, for traffic of random lengths: crc32cWords, then the last
+ * len % 8 bytes from an 8 byte load that ends at the end of the data. It overlaps bytes that were
+ * already done; shifting them out leaves the tail in the low bytes, as in crc32cPaddedTail.
+ * Under 8 bytes there is nothing to overlap and a loop takes one byte at a time.
+ */
+uint32_t crc32cIntelCLoop ( uint32_t crc, const void *buf, size_t len )
+{
+        static constexpr CRC32CTailShift K {};
+        const unsigned char *next = ( const unsigned char * ) buf;
+
+        if ( len < 8 ) {
+                for ( ; len > 0; len-- ) {
+                        crc = __builtin_ia32_crc32qi ( crc, *next++ );
+                }
+                return crc;
+        }
+
+        const uint64_t *next64 = ( const uint64_t* ) next;
+        CRC_NATIVE crc0 = crc32cWords ( crc, next64, len / 8 );
+        size_t tail = len % 8;
+        if ( tail == 0 ) {
+                return crc0;
+        }
+        // two shifts, as a 64 bit shift is undefined when tail is 0
+        uint64_t word = ( * ( const uint64_t* ) ( next + len - 8 ) >> ( 63 - 8 * tail ) ) >> 1;
+        crc0 = CRCword ( crc0, &word );
+        return ( uint32_t ) CRCmultiply ( crc0, K[tail] );
+}
+
+/*
+ * crc32cIntelC in as little code as possible, for callers whose hot loop does not fit the
+ * instruction cache together with a kernel of a KiB or more. There is a single CRCblock: blocks
+ * of 128 words per lane, and the rest, if at least 2 words per lane, in one smaller block. The
+ * few words and bytes that remain run one at a time. Large buffers run at the speed of
+ * crc32cIntelC, the cost is in lengths below 48 bytes.
+ */
+uint32_t crc32cIntelCCompact ( uint32_t crc, const void *buf, size_t len )
+{
+        static constexpr CRC32CShiftTable<2 * 128> K {};
+        const uint64_t *next64 = ( const uint64_t* ) buf;
+        CRC_NATIVE crc0 = crc;
+        size_t words = len / 8;
+
+        while ( words >= 3 * 2 ) {
+                size_t block = words >= 3 * 128 ? 128 : words / 3;
+                crc0 = CRCblock<3> ( crc0, next64, block, K.k );
+                next64 += 3 * block;
+                words -= 3 * block;
+        };
+        for ( ; words > 0; words-- ) {
+                crc0 = CRCword ( crc0, next64++ );
+        }
+        const unsigned char *next = ( const unsigned char* ) next64;
+        for ( len %= 8; len > 0; len-- ) {
+                crc0 = __builtin_ia32_crc32qi ( ( uint32_t ) crc0, *next++ );
+        }
+        return ( uint32_t ) crc0;
+}
+
+/*
+ * CRCfixedBlock with a software prefetch of each lane distance bytes ahead, one per cache line
+ * of each lane. Hint is _MM_HINT_T0, or _MM_HINT_NTA to keep the data out of the outer caches.
+ */
+template <unsigned Lanes, size_t Block, int Hint>
+static inline __attribute__ ( ( always_inline ) )
+CRC_NATIVE CRCprefetchBlock ( CRC_NATIVE crc0, const uint64_t *buf, size_t distance )
+{
+        static_assert ( Block % 8 == 0, "a block is a whole number of cache lines per lane" );
+        static constexpr CRC32CBlockShift<Block, Lanes> K {};
+        const char *ahead = ( const char* ) buf + distance;
+        CRC_NATIVE crc[Lanes] = { crc0 };
+        for ( size_t i = 0; i < Block; i += 8 ) {
+                for ( unsigned j = 0; j < Lanes; j++ ) {
+                        _mm_prefetch ( ahead + 8 * ( j * Block + i ), ( enum _mm_hint ) Hint );
+                }
+                if ( i < Block - 8 ) {
+                        CRCsteps<Lanes, Block> ( crc, buf + i, std::make_index_sequence<8>() );
+                }
+        }
+        CRCsteps<Lanes, Block> ( crc, buf + Block - 8, std::make_index_sequence<7>() );
+        CRClanes<Lanes - 1>::step ( crc, buf + Block - 1, Block );
+        return CombineCRC<Lanes> ( crc, buf + Lanes * Block - 1, Block, K );
+}
+
+// Words per lane in a block of crc32cIntelCStream: 4 KiB lanes, so a prefetch a few cache lines
+// ahead stays in its own lane.
+static const size_t STREAM_BLOCK = 512;
+
+template <int Hint>
+static uint32_t crc32cStreamLanes ( uint32_t crc, const void *buf, size_t len, size_t distance )
+{
+        const uint64_t *next64 = ( const uint64_t* ) buf;
+        CRC_NATIVE crc0 = crc;
+        for ( ; len >= 3 * STREAM_BLOCK * 8; len -= 3 * STREAM_BLOCK * 8 ) {
+                crc0 = CRCprefetchBlock<3, STREAM_BLOCK, Hint> ( crc0, next64, distance );
+                next64 += 3 * STREAM_BLOCK;
+        }
+        return crc32cIntelC ( ( uint32_t ) crc0, next64, len );
+}
+
+/*
+ * crc32cIntelC for large buffers that come from memory rather than cache, see crc32c.h. Blocks
+ * of 12 KiB run with software prefetch, what is left after the last whole block runs through
+ * crc32cIntelC.
+ */
+uint32_t crc32cIntelCStream ( uint32_t crc, const void *buf, size_t len, size_t distance, bool nontemporal )
+{
+        if ( nontemporal ) {
+                return crc32cStreamLanes<_MM_HINT_NTA> ( crc, buf, len, distance );
+        }
+        return crc32cStreamLanes<_MM_HINT_T0> ( crc, buf, len, distance );
+}
+
+uint32_t crc32cIntelCPrefetch ( uint32_t crc, const void *buf, size_t len )
+{
+        return crc32cStreamLanes<_MM_HINT_T0> ( crc, buf, len, CRC32C_PREFETCH_DISTANCE );
+}
+
+/*
+ * Compute the CRC-32C of Lanes whole sectors of words each, one sector per lane. The sectors are
+ * independent, so unlike the kernels above there is no combine step.
+ */
+template <unsigned Lanes>
+static inline void crc32cSectorLanes ( const uint64_t *next64, size_t words, uint32_t *out )
+{
+        CRC_NATIVE crc[Lanes];
+        for ( unsigned j = 0; j < Lanes; j++ ) {
+                crc[j] = crc32cInit();
+        }
+        for ( size_t i = 0; i < words; i++ ) {
+                CRClanes<Lanes>::step ( crc, next64 + i, words );
+        }
+        for ( unsigned j = 0; j < Lanes; j++ ) {
+                out[j] = crc32cFinish ( ( uint32_t ) crc[j] );
+        }
+}
+
+// Number of sectors computed side by side by crc32cSectors. Like crc32cIntelC, three lanes cover
+// the latency of crc32q.
+static const unsigned SECTOR_LANES = 3;
+
+size_t crc32cSectors ( const void *buf, size_t len, size_t sector_size, uint32_t *out )
+{
+        const unsigned char *next = ( const unsigned char * ) buf;
+        if ( sector_size == 0 ) {
+                return 0;
+        }
+        size_t sectors = ( len + sector_size - 1 ) / sector_size;
+        size_t i = 0;
+
+        if ( sector_size % 8 == 0 ) {
+                size_t whole = len / sector_size;
+                for ( ; i + SECTOR_LANES <= whole; i += SECTOR_LANES ) {
+                        crc32cSectorLanes<SECTOR_LANES> ( ( const uint64_t* ) ( next + i * sector_size ), sector_size / 8, out + i );
+                }
+        }
+
+        // the remaining sectors, a short last sector, or sectors that are not a whole number of words
+        for ( ; i < sectors; i++ ) {
+                size_t length = len - i * sector_size < sector_size ? len - i * sector_size : sector_size;
+                out[i] = crc32cFinish ( crc32cIntelC ( crc32cInit(), next + i * sector_size, length ) );
+        }
+        return sectors;
+}
 
 }  // namespace logging
 // kate: indent-mode cstyle; indent-width 8; replace-tabs on; 
@@ -0,0 +1,137 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/* Compute CRC-32C with the pclmulqdq instruction only, for processors or virtual machines
+  that have pclmulqdq but no crc32 instruction. The data is folded 64 bytes at a time into
+  four 128 bit accumulators, as described in Intel's "Fast CRC Computation for Generic
+  Polynomials Using PCLMULQDQ Instruction", then reduced to 32 bits with a Barrett
+  reduction. The constants are computed like those of the linux kernel's crc32-pclmul, for
+  the CRC-32C polynomial: bit reflected, shifted left by one.
+
+  A pshufb nibble table kernel was considered as well. It needs 8 shuffles and as many
+  xors per byte position and still runs a serial chain per 16 bytes, where folding does
+  16 bytes with 2 carry-less multiplies that do not depend on each other.
+
+  crc32cPclmulFold folds the same way but ends with crc32l instructions instead of the
+  Barrett reduction and the byte table. It is meant for 32 bit builds, where crc32q is
+  missing and crc32cIntelC needs two serial crc32l per 64 bit word; the folding itself
+  only uses xmm registers and does not depend on the word size. */
+
+/* Version history:
+  1.0  19 Oct 2026  First version
+  1.1  19 Oct 2026  crc32cPclmulFold, folding with a crc32l reduction
+  1.2  19 Oct 2026  Compiled without -msse4.2, crc32cPclmulFold has it as a target attribute
+*/
+
+#include "logging/crc32c.h"
+#include "logging/crc32cshift.h"
+#include "logging/crc32ctables.h"
+#include <x86intrin.h>
+
+namespace logging
+{
+
+/* floor(x^64 / P), bit reflected, for the Barrett reduction. */
+static const uint64_t CRC32C_BARRETT_MU = 0x0dea713f1ULL;
+
+/* Fold the 128 bits of x further into the data. k holds the constants for the low and the high
+   64 bits of x for the fold distance. */
+static inline __m128i crc32cFold ( __m128i x, __m128i k )
+{
+        return _mm_xor_si128 ( _mm_clmulepi64_si128 ( x, k, 0x00 ), _mm_clmulepi64_si128 ( x, k, 0x11 ) );
+}
+
+/* Fold len >= 16 bytes into 128 bits, with crc xored into the first 16. Returns the 128 bits,
+   whose crc is that of the data, and leaves next and len at the less than 16 bytes after. */
+static inline __m128i crc32cFoldBlocks ( uint32_t crc, const unsigned char *&next, size_t &len )
+{
+        // the low 64 bits of an accumulator are shifted by x^(n+32), the high by x^(n-32)
+        const __m128i k512 = _mm_set_epi64x ( crc32cFoldConstant ( 512 - 32 ), crc32cFoldConstant ( 512 + 32 ) );
+        const __m128i k128 = _mm_set_epi64x ( crc32cFoldConstant ( 128 - 32 ), crc32cFoldConstant ( 128 + 32 ) );
+
+        __m128i x0 = _mm_xor_si128 ( _mm_loadu_si128 ( ( const __m128i* ) next ), _mm_cvtsi32_si128 ( crc ) );
+        next += 16;
+        len -= 16;
+
+        if ( len >= 48 ) {
+                __m128i x1 = _mm_loadu_si128 ( ( const __m128i* ) next );
+                __m128i x2 = _mm_loadu_si128 ( ( const __m128i* ) next + 1 );
+                __m128i x3 = _mm_loadu_si128 ( ( const __m128i* ) next + 2 );
+                next += 48;
+                len -= 48;
+                for ( ; len >= 64; len -= 64 ) {
+                        x0 = _mm_xor_si128 ( crc32cFold ( x0, k512 ), _mm_loadu_si128 ( ( const __m128i* ) next ) );
+                        x1 = _mm_xor_si128 ( crc32cFold ( x1, k512 ), _mm_loadu_si128 ( ( const __m128i* ) next + 1 ) );
+                        x2 = _mm_xor_si128 ( crc32cFold ( x2, k512 ), _mm_loadu_si128 ( ( const __m128i* ) next + 2 ) );
+                        x3 = _mm_xor_si128 ( crc32cFold ( x3, k512 ), _mm_loadu_si128 ( ( const __m128i* ) next + 3 ) );
+                        next += 64;
+                }
+                x0 = _mm_xor_si128 ( crc32cFold ( x0, k128 ), x1 );
+                x0 = _mm_xor_si128 ( crc32cFold ( x0, k128 ), x2 );
+                x0 = _mm_xor_si128 ( crc32cFold ( x0, k128 ), x3 );
+        }
+        for ( ; len >= 16; len -= 16 ) {
+                x0 = _mm_xor_si128 ( crc32cFold ( x0, k128 ), _mm_loadu_si128 ( ( const __m128i* ) next ) );
+                next += 16;
+        }
+        return x0;
+}
+
+uint32_t crc32cPclmul ( uint32_t crc, const void *buf, size_t len )
+{
+        const unsigned char *next = ( const unsigned char * ) buf;
+
+        if ( len >= 16 ) {
+                const __m128i k128 = _mm_set_epi64x ( crc32cFoldConstant ( 128 - 32 ), crc32cFoldConstant ( 128 + 32 ) );
+                const __m128i k64 = _mm_set_epi64x ( 0, crc32cFoldConstant ( 64 ) );
+                const __m128i barrett = _mm_set_epi64x ( CRC32C_BARRETT_MU, ( ( uint64_t ) CRC32C_POLY << 1 ) | 1 );
+                const __m128i mask32 = _mm_set_epi32 ( 0, 0, 0, -1 );
+
+                __m128i x0 = crc32cFoldBlocks ( crc, next, len );
+
+                // 128 to 64 bits, then 64 to 32 bits, both adding 32 zero bits to the data
+                x0 = _mm_xor_si128 ( _mm_srli_si128 ( x0, 8 ), _mm_clmulepi64_si128 ( x0, k128, 0x10 ) );
+                x0 = _mm_xor_si128 ( _mm_srli_si128 ( x0, 4 ), _mm_clmulepi64_si128 ( _mm_and_si128 ( x0, mask32 ), k64, 0x00 ) );
+
+                // Barrett reduction: the quotient from mu, then subtract quotient * P
+                __m128i t = _mm_and_si128 ( _mm_clmulepi64_si128 ( _mm_and_si128 ( x0, mask32 ), barrett, 0x10 ), mask32 );
+                x0 = _mm_xor_si128 ( x0, _mm_clmulepi64_si128 ( t, barrett, 0x00 ) );
+                crc = _mm_extract_epi32 ( x0, 1 );
+        }
+
+        // less than 16 bytes remain, a byte at a time with the smallest table
+        for ( ; len > 0; len-- ) {
+                crc = crc_tableil8_o32[ ( crc ^ *next++ ) & 0x000000FF] ^ ( crc >> 8 );
+        }
+        return crc;
+}
+
+/* The only function of this file that uses crc32; the file itself is compiled for SSE 4.1 and
+   pclmulqdq only, as crc32cPclmul must run where SSE 4.2 is missing. */
+__attribute__ ( ( target ( "sse4.2" ) ) )
+uint32_t crc32cPclmulFold ( uint32_t crc, const void *buf, size_t len )
+{
+        const unsigned char *next = ( const unsigned char * ) buf;
+
+        if ( len >= 16 ) {
+                __m128i x0 = crc32cFoldBlocks ( crc, next, len );
+
+                // the crc of the 16 folded bytes, with crc32l only, so the same on 32 bit platforms
+                crc = __builtin_ia32_crc32si ( 0, _mm_cvtsi128_si32 ( x0 ) );
+                crc = __builtin_ia32_crc32si ( crc, _mm_extract_epi32 ( x0, 1 ) );
+                crc = __builtin_ia32_crc32si ( crc, _mm_extract_epi32 ( x0, 2 ) );
+                crc = __builtin_ia32_crc32si ( crc, _mm_extract_epi32 ( x0, 3 ) );
+        }
+
+        for ( ; len >= sizeof ( uint32_t ); len -= sizeof ( uint32_t ) ) {
+                crc = __builtin_ia32_crc32si ( crc, * ( const uint32_t* ) next );
+                next += sizeof ( uint32_t );
+        }
+        for ( ; len > 0; len-- ) {
+                crc = __builtin_ia32_crc32qi ( crc, *next++ );
+        }
+        return crc;
+}
+
+}  // namespace logging
+// kate: indent-mode cstyle; indent-width 8; replace-tabs on;
@@ -0,0 +1,128 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/* crc32cPclmulFold on 512 bit registers: vpclmulqdq folds the four 128 bit lanes of a zmm
+  register at once, so four zmm accumulators take 256 bytes per iteration. What is left, less
+  than 64 bytes, goes to crc32cPclmulFold. Buffers under 1 KiB go to crc32cIntelC, or on 32 bit
+  builds crc32cPclmulFold, which are faster there.
+
+  This file is compiled with -mavx512f -mvpclmulqdq. Nothing in it may be called before
+  crc32cSupportedISA reports CRC32C_ISA_AVX512, and it must not define inline functions that
+  the other files share, as the linker could keep the AVX-512 copy. */
+
+/* Version history:
+  1.0  19 Oct 2026  First version
+  1.1  19 Oct 2026  No intrinsics with undefined merge operands
+*/
+
+#include "logging/crc32c.h"
+#include "logging/crc32cshift.h"
+#include <x86intrin.h>
+
+namespace logging
+{
+
+/* The fold constants of crc32cPclmul for a distance of n bits, in all four lanes. Not with
+   _mm512_broadcast_i32x4, nor _mm512_extracti32x4_epi32 below: GCC's versions pass an undefined
+   vector for the unused merge operand, which -Wmaybe-uninitialized reports, and so does
+   _mm512_castsi512_si128, which is built on the latter. */
+static inline __m512i crc32cFoldConstants ( uint64_t low, uint64_t high )
+{
+        return _mm512_set_epi64 ( high, low, high, low, high, low, high, low );
+}
+
+/* 128 bit lane I of x. */
+template <int I>
+static inline __m128i crc32cLane ( __m512i x )
+{
+        return _mm512_maskz_extracti32x4_epi32 ( 0xf, x, I );
+}
+
+/* Fold each 128 bit lane of x by k and xor in y. */
+static inline __m512i crc32cFold512 ( __m512i x, __m512i k, __m512i y )
+{
+        return _mm512_ternarylogic_epi64 ( _mm512_clmulepi64_epi128 ( x, k, 0x00 ),
+                                           _mm512_clmulepi64_epi128 ( x, k, 0x11 ), y, 0x96 );
+}
+
+/* Below this the lane reduction and the tail cost more than the wide folds gain. */
+static const size_t VPCLMUL_MIN_LENGTH = 1024;
+
+uint32_t crc32cVpclmul ( uint32_t crc, const void *buf, size_t len )
+{
+        const unsigned char *next = ( const unsigned char * ) buf;
+
+        if ( len < VPCLMUL_MIN_LENGTH ) {
+#ifdef __LP64__
+                return crc32cIntelC ( crc, buf, len );
+#else
+                return crc32cPclmulFold ( crc, buf, len );
+#endif
+        } else {
+                // constant expressions, so no copy of crc32cXPow is compiled for AVX-512
+                static constexpr uint64_t K2048_LOW = crc32cFoldConstant ( 2048 + 32 );
+                static constexpr uint64_t K2048_HIGH = crc32cFoldConstant ( 2048 - 32 );
+                static constexpr uint64_t K512_LOW = crc32cFoldConstant ( 512 + 32 );
+                static constexpr uint64_t K512_HIGH = crc32cFoldConstant ( 512 - 32 );
+                static constexpr uint64_t K384_LOW = crc32cFoldConstant ( 384 + 32 );
+                static constexpr uint64_t K384_HIGH = crc32cFoldConstant ( 384 - 32 );
+                static constexpr uint64_t K256_LOW = crc32cFoldConstant ( 256 + 32 );
+                static constexpr uint64_t K256_HIGH = crc32cFoldConstant ( 256 - 32 );
+                static constexpr uint64_t K128_LOW = crc32cFoldConstant ( 128 + 32 );
+                static constexpr uint64_t K128_HIGH = crc32cFoldConstant ( 128 - 32 );
+
+                const __m512i k2048 = crc32cFoldConstants ( K2048_LOW, K2048_HIGH );
+                const __m512i k512 = crc32cFoldConstants ( K512_LOW, K512_HIGH );
+                // lanes 0 to 2 of the last accumulator are 384, 256 and 128 bits from the end of lane 3
+                const __m512i klanes = _mm512_set_epi64 ( 0, 0, K128_HIGH, K128_LOW, K256_HIGH, K256_LOW,
+                                                          K384_HIGH, K384_LOW );
+
+                __m512i x0 = _mm512_xor_si512 ( _mm512_loadu_si512 ( next ),
+                                                _mm512_zextsi128_si512 ( _mm_cvtsi32_si128 ( crc ) ) );
+                next += 64;
+                len -= 64;
+
+                if ( len >= 192 ) {
+                        __m512i x1 = _mm512_loadu_si512 ( next );
+                        __m512i x2 = _mm512_loadu_si512 ( next + 64 );
+                        __m512i x3 = _mm512_loadu_si512 ( next + 128 );
+                        next += 192;
+                        len -= 192;
+                        for ( ; len >= 256; len -= 256 ) {
+                                x0 = crc32cFold512 ( x0, k2048, _mm512_loadu_si512 ( next ) );
+                                x1 = crc32cFold512 ( x1, k2048, _mm512_loadu_si512 ( next + 64 ) );
+                                x2 = crc32cFold512 ( x2, k2048, _mm512_loadu_si512 ( next + 128 ) );
+                                x3 = crc32cFold512 ( x3, k2048, _mm512_loadu_si512 ( next + 192 ) );
+                                next += 256;
+                        }
+                        x0 = crc32cFold512 ( x0, k512, x1 );
+                        x0 = crc32cFold512 ( x0, k512, x2 );
+                        x0 = crc32cFold512 ( x0, k512, x3 );
+                }
+                for ( ; len >= 64; len -= 64 ) {
+                        x0 = crc32cFold512 ( x0, k512, _mm512_loadu_si512 ( next ) );
+                        next += 64;
+                }
+
+                // four lanes into one: lane 3 is kept as is, its constants are zero
+                __m512i t = crc32cFold512 ( x0, klanes, _mm512_setzero_si512() );
+                __m128i x = _mm_ternarylogic_epi64 ( crc32cLane<0> ( t ), crc32cLane<1> ( t ),
+                                                     crc32cLane<2> ( t ), 0x96 );
+                x = _mm_xor_si128 ( x, crc32cLane<3> ( x0 ) );
+
+                // the crc of the 16 folded bytes
+                crc = __builtin_ia32_crc32si ( 0, _mm_cvtsi128_si32 ( x ) );
+                crc = __builtin_ia32_crc32si ( crc, _mm_extract_epi32 ( x, 1 ) );
+                crc = __builtin_ia32_crc32si ( crc, _mm_extract_epi32 ( x, 2 ) );
+                crc = __builtin_ia32_crc32si ( crc, _mm_extract_epi32 ( x, 3 ) );
+
+                // crc32cPclmulFold has legacy SSE encodings, which are slow with the upper halves
+                // in use; the compiler leaves this out before a tail call
+                _mm256_zeroupper();
+        }
+
+        return crc32cPclmulFold ( crc, next, len );
+}
+
+}  // namespace logging
+// kate: indent-mode cstyle; indent-width 8; replace-tabs on;
@@ -11,7 +11,7 @@
 namespace logging {
 
 /** Returns the initial value for a CRC32-C computation. */
-static inline uint32_t crc32cInit() {
+static inline constexpr uint32_t crc32cInit() {
     return 0xFFFFFFFF;
 }
 
@@ -27,18 +27,207 @@ extern CRC32CFunctionPtr crc32c;
 
 CRC32CFunctionPtr detectBestCRC32C();
 
+/** How detectBestCRC32C picks its kernel, for logging at startup. Processors with SSE 4.2 and
+pclmulqdq are looked up by vendor, family and model in a built-in table of microarchitectures;
+the others, and those not in the table, get a kernel by their feature bits alone. The
+CRC32C_KERNEL environment variable, if it names a usable kernel, overrides both. */
+struct CRC32CDispatch {
+    char vendor[13];                /**< cpuid vendor string, such as "GenuineIntel" */
+    unsigned family;                /**< cpuid family, with the extended family added */
+    unsigned model;                 /**< cpuid model, with the extended model */
+    bool sse42;                     /**< the crc32 instruction */
+    bool pclmul;                    /**< pclmulqdq and SSE 4.1 */
+    bool forced;                    /**< kernel set by the CRC32C_KERNEL environment variable */
+    const char* microarchitecture;  /**< the table entry used, or NULL if none matched */
+    const char* kernel;             /**< name of the chosen function */
+    CRC32CFunctionPtr function;     /**< what detectBestCRC32C returns */
+};
+
+CRC32CDispatch crc32cDispatch();
+
+/** Instruction set extensions a kernel needs, for CRC32CKernel::isa. */
+enum {
+    CRC32C_ISA_NONE = 0,
+    CRC32C_ISA_SSE42 = 1,   /**< the crc32 instruction */
+    CRC32C_ISA_PCLMUL = 2,  /**< pclmulqdq and SSE 4.1 */
+    CRC32C_ISA_AVX512 = 4,  /**< AVX-512F, AVX-512VL and vpclmulqdq, enabled by the OS */
+};
+
+/** A kernel built into the library. */
+struct CRC32CKernel {
+    const char* name;           /**< function name, such as "crc32cIntelC" */
+    unsigned isa;               /**< CRC32C_ISA_ bits it needs */
+    size_t minLength;           /**< shortest length it is efficient for */
+    size_t maxLength;           /**< longest length it is efficient for, SIZE_MAX for no limit */
+    CRC32CFunctionPtr function;
+};
+
+/** All kernels of the library, whether this processor can run them or not.
+@arg count receives the number of kernels.
+*/
+const CRC32CKernel* crc32cKernels(size_t* count);
+
+/** The CRC32C_ISA_ bits of this processor. */
+unsigned crc32cSupportedISA();
+
+/** True if this processor has the instructions the kernel needs. */
+bool crc32cKernelUsable(const CRC32CKernel& kernel);
+
+/** The kernel with this name, or NULL. */
+const CRC32CKernel* crc32cFindKernel(const char* name);
+
+/** Makes crc32c use the named kernel, or detect the best one again on its next call if name is
+NULL. Not thread safe: call it before other threads use crc32c. Setting the CRC32C_KERNEL
+environment variable has the same effect without a code change.
+@return false, leaving crc32c unchanged, if there is no usable kernel of that name.
+*/
+bool crc32cForceKernel(const char* name);
+
+/** Number of length buckets of CRC32CKernelStats. Bucket 0 counts calls of 0 bytes, bucket b
+calls of 2^(b-1) to 2^b - 1 bytes; the last one also counts all longer calls. */
+static const size_t CRC32C_STATS_BUCKETS = 33;
+
+/** Calls through crc32c to one kernel, summed over all threads. */
+struct CRC32CKernelStats {
+    const char* name;           /**< the kernel, as in CRC32CKernel */
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t buckets[CRC32C_STATS_BUCKETS];  /**< calls by log2 of the length */
+};
+
+/** Turns counting of the calls through crc32c on or off. While on, crc32c points at a wrapper
+that counts per thread, per kernel, the calls, the bytes and the calls by length, then calls the
+kernel. While off, crc32c points at the kernel itself and the counting costs nothing. Off by
+default; CRC32C_STATS=1 in the environment turns it on from the start. Not thread safe, like
+crc32cForceKernel. */
+void crc32cEnableStats(bool enable);
+
+/** True while crc32cEnableStats is on. */
+bool crc32cStatsEnabled();
+
+/** What crc32c points at to use this kernel: the kernel, or while counting, the wrapper. */
+CRC32CFunctionPtr crc32cStatsFunction(const CRC32CKernel& kernel);
+
+/** Sums the counters of all threads, including those that have exited.
+@arg out receives the kernels with at least one call, in the order of crc32cKernels.
+@arg max size of out.
+@return the number of entries written.
+*/
+size_t crc32cStatsSnapshot(CRC32CKernelStats* out, size_t max);
+
 /** Converts a partial CRC32-C computation to the final value. */
-static inline uint32_t crc32cFinish(uint32_t crc) {
+static inline constexpr uint32_t crc32cFinish(uint32_t crc) {
     return ~crc;
 }
 
+/** Computes a CRC32-C at compile time, bit by bit with the same reflected polynomial
+as crc32cSarwate, so it can be used in static_asserts, case labels and template arguments.
+At run time it is slow; use crc32c instead.
+@arg crc Previous CRC32C value, or crc32cInit().
+@arg data Pointer to the data to be checksummed.
+@arg length length of the data in bytes.
+*/
+constexpr uint32_t crc32cConst(uint32_t crc, const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        crc ^= (unsigned char) data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+        }
+    }
+    return crc;
+}
+
+/** The final CRC32-C of a string literal, without its terminating zero, at compile time. */
+template <size_t N>
+constexpr uint32_t crc32cLiteral(const char (&s)[N]) {
+    return crc32cFinish(crc32cConst(crc32cInit(), s, N - 1));
+}
+
 uint32_t crc32cSarwate(uint32_t crc, const void* data, size_t length);
+/** crc32cSarwate with a 64 byte table, 4 bits per lookup. */
+uint32_t crc32cNibble(uint32_t crc, const void* data, size_t length);
+/** crc32cSarwate with two 16 entry tables, 128 bytes, both nibbles of a byte per step. */
+uint32_t crc32cNibblePair(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cSlicingBy4(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cSlicingBy8(uint32_t crc, const void* data, size_t length);
+/** Slicing by 16 bytes with 64 bit loads from an 8 byte aligned pointer, 16 KiB of tables. */
+uint32_t crc32cSlicingBy16(uint32_t crc, const void* data, size_t length);
+/** Portable crc without intrinsics, five interleaved table lookup chains like zlib's braided
+crc32. Used when the processor has no crc32 instruction. */
+uint32_t crc32cBraid(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cHardware32(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cHardware64(uint32_t crc, const void* data, size_t length);
+/** crc folded with pclmulqdq, without the crc32 instruction or large tables. Needs pclmulqdq
+and SSE 4.1. */
+uint32_t crc32cPclmul(uint32_t crc, const void* data, size_t length);
+/** crc32cPclmul with the last 16 bytes and the tail done by crc32l instead of a Barrett
+reduction. Needs SSE 4.2 and pclmulqdq, and uses no crc32q, for 32 bit builds. */
+uint32_t crc32cPclmulFold(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cAdler(uint32_t crc, const void* data, size_t length);
+/** crc32cAdler combining its lanes with pclmulqdq instead of 8 KiB of shift tables. */
+uint32_t crc32cAdlerPclmul(uint32_t crc, const void* data, size_t length);
+/** crc32cAdlerPclmul with lanes of 8192, 1024, 256 and 64 bytes instead of 8192 and 256. */
+uint32_t crc32cAdlerTiered(uint32_t crc, const void* data, size_t length);
 uint32_t crc32cIntelC(uint32_t crc, const void* data, size_t length);
+/** crc32cIntelC with the block size picked from the input length: up to 96 KiB in a single block. */
+uint32_t crc32cIntelCAdaptive(uint32_t crc, const void* data, size_t length);
+/** crc32cIntelC for exactly N bytes, with the length handling done at compile time.
+N is a power of two from 256 to 65536. */
+template <size_t N>
+uint32_t crc32cFixed(uint32_t crc, const void* data);
+/** crc32cIntelC without jump tables: the same code runs for all lengths, so mixed random
+lengths do not cost branch mispredictions. */
+uint32_t crc32cIntelCLoop(uint32_t crc, const void* data, size_t length);
+/** crc32cIntelC as a small rolled loop, for when instruction cache space matters more than
+speed on short buffers. */
+uint32_t crc32cIntelCCompact(uint32_t crc, const void* data, size_t length);
+/** Default prefetch distance of crc32cIntelCPrefetch in bytes. */
+static const size_t CRC32C_PREFETCH_DISTANCE = 512;
+
+/** crc32cIntelC for large buffers that are not in the cache, such as freshly mapped files.
+Each of the three lanes prefetches the data distance bytes ahead of itself. With nontemporal,
+the prefetches use the NTA hint so the buffer does not displace other data from the last level
+cache. Buffers under 12 KiB run as crc32cIntelC.
+*/
+uint32_t crc32cIntelCStream(uint32_t crc, const void* data, size_t length, size_t distance,
+        bool nontemporal);
+/** crc32cIntelCStream with CRC32C_PREFETCH_DISTANCE and temporal prefetches. */
+uint32_t crc32cIntelCPrefetch(uint32_t crc, const void* data, size_t length);
+/** crc32cIntelC with 2, 4, 5, 6, 7 or 8 lanes instead of 3. */
+uint32_t crc32cIntelC2(uint32_t crc, const void* data, size_t length);
+uint32_t crc32cIntelC4(uint32_t crc, const void* data, size_t length);
+uint32_t crc32cIntelC5(uint32_t crc, const void* data, size_t length);
+uint32_t crc32cIntelC6(uint32_t crc, const void* data, size_t length);
+uint32_t crc32cIntelC7(uint32_t crc, const void* data, size_t length);
+uint32_t crc32cIntelC8(uint32_t crc, const void* data, size_t length);
+/** crc32cPclmulFold with 512 bit vpclmulqdq, 256 bytes per iteration, for buffers of 1 KiB and
+more; shorter ones go to crc32cIntelC. Needs CRC32C_ISA_AVX512 as well as SSE 4.2 and pclmulqdq. */
+uint32_t crc32cVpclmul(uint32_t crc, const void* data, size_t length);
+/** Number of bytes after the data that crc32cPadded may read. */
+static const size_t CRC32C_PADDING = 8;
+
+/** crc32cIntelC for data that is followed by at least CRC32C_PADDING readable bytes. It reads
+them with full 8 byte loads instead of handling the last bytes one by one; their contents do not
+matter. Buffers from crc32cPaddedAlloc have the padding.
+*/
+uint32_t crc32cPadded(uint32_t crc, const void* data, size_t length);
+
+/** Allocates length bytes for use with crc32cPadded: 64 byte aligned, with CRC32C_PADDING
+bytes after them. Returns NULL if out of memory. Free with crc32cPaddedFree.
+*/
+void* crc32cPaddedAlloc(size_t length);
+void crc32cPaddedFree(void* buffer);
+
+/** Computes the CRC32-C of each sector of data, several sectors at a time.
+@arg data Pointer to the data to be checksummed.
+@arg length length of the data in bytes. If it is not a multiple of sector_size, the last
+sector is shorter.
+@arg sector_size size of a sector in bytes, usually 512 or 4096. With 0 nothing is computed.
+@arg out receives the final CRC32-C (crc32cInit() to crc32cFinish()) of each sector.
+@return the number of sectors, (length + sector_size - 1) / sector_size, or 0 if sector_size is 0.
+*/
+size_t crc32cSectors(const void* data, size_t length, size_t sector_size, uint32_t* out);
+
 uint32_t crc32cIntelAsm(uint32_t crc, const void *buf, size_t len);
 
 }  // namespace logging
@@ -0,0 +1,150 @@
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/* Compile time generation of the constants needed to shift a CRC-32C over a
+   run of zero bits. All values are bit reflected, like the crc itself: bit 31
+   holds the coefficient of x^0 and bit 0 the coefficient of x^31.
+
+   A crc multiplied (pclmulqdq) by K(n) = x^(64n-33) mod P gives a 64 bit value
+   whose crc32q equals the crc shifted over n 64 bit words. This is what the
+   combine step of the multi lane kernels uses, and what Intel's K_table in
+   crc_iscsi_v_pcl.asm holds (in 33 bit form, x^(64n-32) mod P) for n = 1..256. */
+
+#ifndef LOGGING_CRC32CSHIFT_H__
+#define LOGGING_CRC32CSHIFT_H__
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace logging {
+
+/* CRC-32C (iSCSI) polynomial in reversed bit order. */
+static const uint32_t CRC32C_POLY = 0x82f63b78;
+
+/* Multiply a bit reflected polynomial by x modulo P. */
+constexpr uint32_t crc32cMulX(uint32_t a) {
+    return (a >> 1) ^ ((a & 1) ? CRC32C_POLY : 0);
+}
+
+/* Divide a bit reflected polynomial by x modulo P, the inverse of crc32cMulX. P has a
+   constant term, so x is invertible. */
+constexpr uint32_t crc32cDivX(uint32_t a) {
+    return (a & 0x80000000) ? ((a ^ CRC32C_POLY) << 1) | 1 : a << 1;
+}
+
+/* a * b mod P, bit reflected. */
+constexpr uint32_t crc32cMultiply(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t m = 0x80000000; m != 0; m >>= 1) {
+        if (a & m) {
+            product ^= b;
+        }
+        b = crc32cMulX(b);
+    }
+    return product;
+}
+
+/* x^n mod P, bit reflected, by repeated squaring. */
+constexpr uint32_t crc32cXPow(uint64_t n) {
+    uint32_t power = 0x80000000;    // x^0
+    uint32_t square = 0x40000000;   // x^1
+    for (; n != 0; n >>= 1) {
+        if (n & 1) {
+            power = crc32cMultiply(power, square);
+        }
+        square = crc32cMultiply(square, square);
+    }
+    return power;
+}
+
+/* x^n mod P, bit reflected and shifted left by one, as the pclmulqdq fold steps of
+   crc32cPclmul and crc32cVpclmul use it. */
+constexpr uint64_t crc32cFoldConstant(unsigned n) {
+    return (uint64_t) crc32cXPow(n) << 1;
+}
+
+/* x^-n mod P, bit reflected, for small n. */
+constexpr uint32_t crc32cXPowInverse(unsigned n) {
+    uint32_t power = 0x80000000;    // x^0
+    for (unsigned i = 0; i < n; ++i) {
+        power = crc32cDivX(power);
+    }
+    return power;
+}
+
+/* Table of K(n) = x^(64n-33) mod P for n = 1..N. Entry 0 is unused. */
+template <size_t N>
+struct CRC32CShiftTable {
+    uint32_t k[N + 1];
+
+    constexpr CRC32CShiftTable() : k() {
+        uint32_t a = crc32cXPow(31);
+        for (size_t n = 1; n <= N; ++n) {
+            k[n] = a;
+            for (int i = 0; i < 64; ++i) {
+                a = crc32cMulX(a);
+            }
+        }
+    }
+
+    constexpr uint32_t operator[](size_t n) const {
+        return k[n];
+    }
+};
+
+/* The K(n) a combine of Lanes lanes of a fixed Block words needs: K(Block) up to
+   K((Lanes - 1) * Block). Indexed like a CRC32CShiftTable, with multiples of Block. */
+template <size_t Block, unsigned Lanes>
+struct CRC32CBlockShift {
+    uint32_t k[Lanes];
+
+    constexpr CRC32CBlockShift() : k() {
+        for (unsigned i = 1; i < Lanes; ++i) {
+            k[i] = crc32cXPow(64 * i * Block - 33);
+        }
+    }
+
+    constexpr uint32_t operator[](size_t n) const {
+        return k[n / Block];
+    }
+};
+
+/* K(n) = x^(64n-33) mod P for n up to N, split as n = 64 * h + l: K(n) is high[h] * low[l] * x^33,
+   which a pclmulqdq and a crc32 compute (CRCmultiply in crc32intelc.h). Two tables of 64 and
+   N / 64 + 1 entries take the place of a CRC32CShiftTable<N> when n is only known at run time. */
+template <size_t N>
+struct CRC32CSplitShift {
+    uint32_t low[64];
+    uint32_t high[N / 64 + 1];
+
+    constexpr CRC32CSplitShift() : low(), high() {
+        low[0] = crc32cXPowInverse(33);
+        for (size_t l = 1; l < 64; ++l) {
+            low[l] = crc32cXPow(64 * l - 33);
+        }
+        high[0] = crc32cXPowInverse(33);
+        for (size_t h = 1; h <= N / 64; ++h) {
+            high[h] = crc32cXPow(64 * 64 * h - 33);
+        }
+    }
+};
+
+/* The crc32 of a word that holds n < 8 bytes of data followed by 8 - n zero bytes is the
+   crc of the n bytes times x^(8(8-n)). k[n] = x^(-8(8-n)-33) mod P takes it back with a
+   pclmulqdq and a crc32 (see CRCmultiply in crc32intelc.h). */
+struct CRC32CTailShift {
+    uint32_t k[8];
+
+    constexpr CRC32CTailShift() : k() {
+        for (unsigned n = 0; n < 8; ++n) {
+            k[n] = crc32cXPowInverse(8 * (8 - n) + 33);
+        }
+    }
+
+    constexpr uint32_t operator[](size_t n) const {
+        return k[n];
+    }
+};
+
+}  // namespace logging
+#endif
@@ -17,6 +17,15 @@ extern const uint32_t crc_tableil8_o64[256];
 extern const uint32_t crc_tableil8_o72[256];
 extern const uint32_t crc_tableil8_o80[256];
 extern const uint32_t crc_tableil8_o88[256];
+extern const uint32_t crc_tableil8_o96[256];
+extern const uint32_t crc_tableil8_o104[256];
+extern const uint32_t crc_tableil8_o112[256];
+extern const uint32_t crc_tableil8_o120[256];
+extern const uint32_t crc_tableil8_o128[256];
+extern const uint32_t crc_tableil8_o136[256];
+extern const uint32_t crc_tableil8_o144[256];
+extern const uint32_t crc_tableil8_o152[256];
+extern const uint32_t crc_tableil4_o32[16];
 
 }
 #endif
@@ -38,8 +38,20 @@
 
 /* Version history:
   1.0  07 May 2016  Ferry Toth - First version
+  1.1  19 Oct 2026  CRCtriplet, CRCduplet and CombineCRC replaced by templates on the lane count
+  1.2  19 Oct 2026  CRCfixedBlock for blocks of a size known at compile time
+  1.3  19 Oct 2026  CRCmultiply
 */
 
+#ifndef LOGGING_CRC32INTELC_H__
+#define LOGGING_CRC32INTELC_H__
+
+#include <stdint.h>
+#include <utility>
+#include <x86intrin.h>
+
+#include "crc32cshift.h"
+
 #ifndef __LP64__
 #define CRC_NATIVE uint32_t
 #else
@@ -47,88 +59,145 @@
 #endif
 
 #ifndef __LP64__
-#define CRCtriplet(crc, buf, offset) \
-    crc ## 0 = __builtin_ia32_crc32si(crc ## 0, *((uint32_t*) buf ## 0 + 2 * offset)); \
-    crc ## 1 = __builtin_ia32_crc32si(crc ## 1, *((uint32_t*) buf ## 1 + 2 * offset)); \
-    crc ## 2 = __builtin_ia32_crc32si(crc ## 2, *((uint32_t*) buf ## 2 + 2 * offset)); \
-    crc ## 0 = __builtin_ia32_crc32si(crc ## 0, *((uint32_t*) buf ## 0 + 1 + 2 * offset)); \
-    crc ## 1 = __builtin_ia32_crc32si(crc ## 1, *((uint32_t*) buf ## 1 + 1 + 2 * offset)); \
-    crc ## 2 = __builtin_ia32_crc32si(crc ## 2, *((uint32_t*) buf ## 2 + 1 + 2 * offset));
+#define CRCsinglet(crc, buf, offset) \
+    crc = __builtin_ia32_crc32si(crc, *(uint32_t*)(buf + offset)); \
+    crc = __builtin_ia32_crc32si(crc, *(uint32_t*)(buf + offset + sizeof(uint32_t)));
 #else
-#define CRCtriplet(crc, buf, offset) \
-    crc ## 0 = __builtin_ia32_crc32di(crc ## 0, *(buf ## 0 + offset)); \
-    crc ## 1 = __builtin_ia32_crc32di(crc ## 1, *(buf ## 1 + offset)); \
-    crc ## 2 = __builtin_ia32_crc32di(crc ## 2, *(buf ## 2 + offset));
+#define CRCsinglet(crc, buf, offset) crc = __builtin_ia32_crc32di(crc, *(uint64_t*)(buf + offset));
 #endif
 
+namespace logging
+{
+
+/* crc32 of one 64 bit word. On 32 bit platforms this takes two crc32l. */
+static inline CRC_NATIVE CRCword ( CRC_NATIVE crc, const uint64_t *buf )
+{
 #ifndef __LP64__
-#define CRCduplet(crc, buf, offset) \
-    crc ## 0 = __builtin_ia32_crc32si(crc ## 0, *((uint32_t*) buf ## 0 + 2 * offset)); \
-    crc ## 1 = __builtin_ia32_crc32si(crc ## 1, *((uint32_t*) buf ## 1 + 2 * offset)); \
-    crc ## 0 = __builtin_ia32_crc32si(crc ## 0, *((uint32_t*) buf ## 0 + 1 + 2 * offset)); \
-    crc ## 1 = __builtin_ia32_crc32si(crc ## 1, *((uint32_t*) buf ## 1 + 1 + 2 * offset));
+        crc = __builtin_ia32_crc32si ( crc, * ( const uint32_t* ) buf );
+        return __builtin_ia32_crc32si ( crc, * ( ( const uint32_t* ) buf + 1 ) );
 #else
-#define CRCduplet(crc, buf, offset) \
-    crc ## 0 = __builtin_ia32_crc32di(crc ## 0, *(buf ## 0 + offset)); \
-    crc ## 1 = __builtin_ia32_crc32di(crc ## 1, *(buf ## 1 + offset));
+        return __builtin_ia32_crc32di ( crc, *buf );
 #endif
+}
+
+/*
+ * CRClanes runs one crc32 on each of the first Lanes lanes. Lane i starts i * stride
+ * words after lane 0. It replaces the CRCtriplet and CRCduplet macros, which were
+ * hardwired to 3 and 2 lanes.
+ */
+template <unsigned Lanes>
+struct CRClanes {
+        static inline __attribute__ ( ( always_inline ) )
+        void step ( CRC_NATIVE *crc, const uint64_t *buf, size_t stride ) {
+                CRClanes<Lanes - 1>::step ( crc, buf, stride );
+                crc[Lanes - 1] = CRCword ( crc[Lanes - 1], buf + ( Lanes - 1 ) * stride );
+        }
+};
 
+template <>
+struct CRClanes<0> {
+        static inline __attribute__ ( ( always_inline ) )
+        void step ( CRC_NATIVE *, const uint64_t *, size_t ) {}
+};
 
+/*
+ * CombineCRC performs pclmulqdq multiplication of each partial CRC but the last with a
+ * well chosen constant and xor's these with the last word of the last lane. The crc32 of
+ * that word on the crc of the last lane gives the CRC of the whole block. K[n] shifts a
+ * crc over n words (see crc32cshift.h), so lane i is shifted over (Lanes - 1 - i) * block
+ * words. For 3 lanes this is what Intel's code does with its K_table. K is a table like
+ * CRC32CShiftTable, or a CRC32CBlockShift when the block size is a constant.
+ * On 32 bit platforms there is no movq from xmm to a general register, so the 64 bit
+ * product is moved out in 2 steps for the final crc32l's.
+ * The target attribute lets crc32cbench, which is built for any x86, inline it into its
+ * combine benchmark.
+ */
+template <unsigned Lanes, class Table>
+static inline __attribute__ ( ( always_inline, target ( "sse4.2,pclmul" ) ) )
+CRC_NATIVE CombineCRC ( const CRC_NATIVE *crc, const uint64_t *last, size_t block, const Table &K )
+{
+        __m128i sum = _mm_loadl_epi64 ( ( const __m128i* ) last );
+        for ( unsigned i = 0; i < Lanes - 1; i++ ) {
+                __m128i k = _mm_cvtsi32_si128 ( K[ ( Lanes - 1 - i ) * block] );
+                __m128i c = _mm_cvtsi32_si128 ( ( uint32_t ) crc[i] );
+                sum = _mm_xor_si128 ( sum, _mm_clmulepi64_si128 ( c, k, 0x00 ) );
+        }
 #ifndef __LP64__
-#define CRCsinglet(crc, buf, offset) \
-    crc = __builtin_ia32_crc32si(crc, *(uint32_t*)(buf + offset)); \
-    crc = __builtin_ia32_crc32si(crc, *(uint32_t*)(buf + offset + sizeof(uint32_t)));
+        CRC_NATIVE crc32bit = __builtin_ia32_crc32si ( crc[Lanes - 1], _mm_cvtsi128_si32 ( sum ) );
+        return __builtin_ia32_crc32si ( crc32bit, _mm_extract_epi32 ( sum, 1 ) );
 #else
-#define CRCsinglet(crc, buf, offset) crc = __builtin_ia32_crc32di(crc, *(uint64_t*)(buf + offset));
+        return __builtin_ia32_crc32di ( crc[Lanes - 1], _mm_cvtsi128_si64 ( sum ) );
 #endif
-
+}
 
 /*
- * CombineCRC performs pclmulqdq multiplication of 2 partial CRC's and a well chosen constant 
- * and xor's these with the remaining CRC. I (Ferry Toth) could not find a way to implement this in
- * C, so the 64bit code following here is from Intel. As that code runs only on 64 bit (due to movq
- * instructions), I am providing a 32bit variant that does the same but using movd. The 32bit
- * version keeps intermediate results longer in the xmm registers to do the 2nd xor, then moves the
- * longs in 2 steps for the final crc32l
- * 
-*/
-
+ * CRCmultiply returns crc * k * x^33 mod P: the 64 bit pclmulqdq product of crc and k, reduced
+ * by a crc32 on 0. With k = x^(n-33) mod P it shifts crc over n bits, n may be negative.
+ */
+static inline __attribute__ ( ( always_inline ) )
+CRC_NATIVE CRCmultiply ( CRC_NATIVE crc, uint32_t k )
+{
+        __m128i product = _mm_clmulepi64_si128 ( _mm_cvtsi32_si128 ( ( uint32_t ) crc ), _mm_cvtsi32_si128 ( k ), 0x00 );
 #ifndef __LP64__
-#define CombineCRC()\
-asm volatile (\
-"movdqu (%3), %%xmm0\n\t"\
-"movd %0, %%xmm1\n\t"\
-"pclmullqlqdq %%xmm0, %%xmm1\n\t"\
-"movd %2, %%xmm2\n\t"\
-"pclmullqhqdq %%xmm0, %%xmm2\n\t"\
-"pxor %%xmm2, %%xmm1\n\t"\
-"movdqu (%4), %%xmm2\n\t"\
-"pxor %%xmm2, %%xmm1\n\t"\
-"movd %%xmm1, %0\n\t"\
-"crc32l %0, %5\n\t"\
-"pextrd $1, %%xmm1, %1\n\t"\
-"crc32l %1, %5\n\t"\
-"movl %5, %0"\
-: "=r" ( crc0 )\
-: "0" ( crc0 ), "r" ( crc1 ), "r" ( K + block_size - 1 ), "r" ( ( uint64_t* ) next2 - 1 ), "r" ( crc2 )\
-: "%xmm0", "%xmm1", "%xmm2"\
-);
+        CRC_NATIVE crc32bit = __builtin_ia32_crc32si ( 0, _mm_cvtsi128_si32 ( product ) );
+        return __builtin_ia32_crc32si ( crc32bit, _mm_extract_epi32 ( product, 1 ) );
 #else
-#define CombineCRC()\
-asm volatile (\
-"movdqa (%3), %%xmm0\n\t"\
-"movq %0, %%xmm1\n\t"\
-"pclmullqlqdq %%xmm0, %%xmm1\n\t"\
-"movq %2, %%xmm2\n\t"\
-"pclmullqhqdq %%xmm0, %%xmm2\n\t"\
-"pxor %%xmm2, %%xmm1\n\t"\
-"movq %%xmm1, %0"\
-: "=r" ( crc0 ) \
-: "0" ( crc0 ), "r" ( crc1 ), "r" ( K + block_size - 1 ) \
-: "%xmm0", "%xmm1", "%xmm2"\
-); \
-crc0 = crc0 ^ * ( ( uint64_t* ) next2 - 1 );\
-crc2 = __builtin_ia32_crc32di ( crc2, crc0 );\
-crc0 = crc2;
+        return __builtin_ia32_crc32di ( 0, _mm_cvtsi128_si64 ( product ) );
+#endif
+}
+
+/*
+ * CRCblock computes the crc of Lanes * block words starting at buf, running Lanes
+ * independent crc32 chains of block words each. The first lane continues from crc0,
+ * the others start at 0 and are merged by CombineCRC. The final step is one lane short,
+ * its word is folded in by CombineCRC.
+ */
+template <unsigned Lanes, class Table>
+static inline __attribute__ ( ( always_inline ) )
+CRC_NATIVE CRCblock ( CRC_NATIVE crc0, const uint64_t *buf, size_t block, const Table &K )
+{
+        CRC_NATIVE crc[Lanes] = { crc0 };
+        for ( size_t i = 0; i < block - 1; i++ ) {
+                CRClanes<Lanes>::step ( crc, buf + i, block );
+        }
+        CRClanes<Lanes - 1>::step ( crc, buf + block - 1, block );
+        return CombineCRC<Lanes> ( crc, buf + Lanes * block - 1, block, K );
+}
+
+/* CRCsteps runs sizeof...(I) steps of CRClanes, fully unrolled at compile time. */
+template <unsigned Lanes, size_t Block, size_t... I>
+static inline __attribute__ ( ( always_inline ) )
+void CRCsteps ( CRC_NATIVE *crc, const uint64_t *buf, std::index_sequence<I...> )
+{
+        int expand[] = { 0, ( CRClanes<Lanes>::step ( crc, buf + I, Block ), 0 )... };
+        ( void ) expand;
+        ( void ) crc;           // unused when there are no steps
+        ( void ) buf;
+}
+
+/*
+ * CRCblock for a Block known at compile time: all offsets are constants and there is no loop
+ * control up to 256 steps per lane. Longer blocks run a loop of 16 unrolled steps, as fully
+ * unrolling them would take several KiB of code per block size.
+ */
+template <unsigned Lanes, size_t Block>
+static inline __attribute__ ( ( always_inline ) )
+CRC_NATIVE CRCfixedBlock ( CRC_NATIVE crc0, const uint64_t *buf )
+{
+        static_assert ( Block >= 2, "a fixed block takes at least 2 words per lane" );
+        static constexpr CRC32CBlockShift<Block, Lanes> K {};
+        static const size_t Unroll = Block - 1 <= 256 ? Block - 1 : 16;
+        static const size_t Rolled = ( Block - 1 ) / Unroll * Unroll;
+        CRC_NATIVE crc[Lanes] = { crc0 };
+        for ( size_t i = 0; i < Rolled; i += Unroll ) {
+                CRCsteps<Lanes, Block> ( crc, buf + i, std::make_index_sequence<Unroll>() );
+        }
+        CRCsteps<Lanes, Block> ( crc, buf + Rolled, std::make_index_sequence<Block - 1 - Rolled>() );
+        CRClanes<Lanes - 1>::step ( crc, buf + Block - 1, Block );
+        return CombineCRC<Lanes> ( crc, buf + Lanes * Block - 1, Block, K );
+}
+
+}  // namespace logging
+
 #endif
 // kate: indent-mode cstyle; indent-width 4; replace-tabs on; 
@@ -5,59 +5,47 @@
 
 namespace logging {
 
+/* Times a piece of code in time stamp counter ticks, which run at a fixed rate, not at the
+   current core clock. start() runs lfence, rdtsc, lfence: the counter is read after the code
+   before it and before the timed code starts. end() reads the counter with rdtscp, which waits
+   for the timed code, and then keeps the code after it out with lfence. Unlike cpuid, lfence
+   does not exit to the hypervisor in a virtual machine.
+   end() needs rdtscp (cpuid 0x80000001, edx bit 27). */
 class CycleTimer {
 public:
     void start() {
-        cpuSync();
+        asm volatile("lfence" ::: "memory");
         start_ = rdtsc();
+        asm volatile("lfence" ::: "memory");
     }
 
     void end() {
-        cpuSync();
-        end_ = rdtsc();
+        end_ = rdtscp();
+        asm volatile("lfence" ::: "memory");
     }
 
-    uint32_t getCycles() {
+    uint64_t getCycles() {
         return end_ - start_;
     }
 
-private:
-    uint32_t rdtsc() {
-#ifdef __x86_64__
+    static uint64_t rdtsc() {
         uint32_t low;
         uint32_t high;
-        asm volatile("rdtsc" : "=a"(low), "=d" (high));
-        return low;
-#elif defined(__i386__)
-        uint64_t tsc;
-        asm volatile("rdtsc" : "=A" (tsc));
-        return (uint32_t) tsc;
-#else
-#error unsupported
-#endif
+        asm volatile("rdtsc" : "=a" (low), "=d" (high) :: "memory");
+        return ((uint64_t) high << 32) | low;
     }
 
-    void cpuSync() {
-        // Calls CPUID to force the pipeline to be flushed
-        uint32_t eax;
-        uint32_t ebx;
-        uint32_t ecx;
-        uint32_t edx;
-#ifdef __PIC__
-        // PIC: Need to save and restore ebx See:
-        // http://sam.zoy.org/blog/2007-04-13-shlib-with-non-pic-code-have-inline-assembly-and-pic-mix-well
-        asm("pushl %%ebx\n\t" /* save %ebx */
-                "cpuid\n\t"
-                "movl %%ebx, %[ebx]\n\t" /* save what cpuid just put in %ebx */
-                "popl %%ebx" : "=a"(eax), [ebx] "=r"(ebx), "=c"(ecx), "=d"(edx) : "a" (0)
-                : "cc");
-#else
-        asm("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (0));
-#endif
+    static uint64_t rdtscp() {
+        uint32_t low;
+        uint32_t high;
+        uint32_t aux;
+        asm volatile("rdtscp" : "=a" (low), "=d" (high), "=c" (aux) :: "memory");
+        return ((uint64_t) high << 32) | low;
     }
 
-    uint32_t start_;
-    uint32_t end_;
+private:
+    uint64_t start_;
+    uint64_t end_;
 };
 
 }